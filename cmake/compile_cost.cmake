@@ -0,0 +1,224 @@
+# Compiles generated translation units that instantiate each candidate and its std counterpart with TYPES element
+# types and the first OPERATIONS operations of each list in src/compile_cost.h, and reports the frontend and backend
+# time and object size each adds over a unit that only includes the headers. GCC's -ftime-report and Clang's
+# -ftime-trace give the split between frontend and backend. Each unit is compiled REPEATS times and the fastest
+# taken, as the differences are small next to a single compile's noise.
+#
+# Expects COMPILER, COMPILER_ID, STANDARD, SOURCE_DIR, OUTPUT_DIR, TYPES, OPERATIONS and REPEATS, and DEFINITIONS
+# and OPTIONS as |-separated lists.
+
+string(REPLACE "|" ";" definitions "${DEFINITIONS}")
+string(REPLACE "|" ";" options "${OPTIONS}")
+list(TRANSFORM definitions PREPEND "-D")
+
+# Suite, function in compile_cost.h, candidate and std counterpart
+set(containers
+	"vector|vector_operations|my_vector|std::vector"
+	"deque|deque_operations|my_deque|std::deque"
+	"unique_ptr|unique_ptr_operations|my_unique_ptr|std::unique_ptr"
+	"shared_ptr|shared_ptr_operations|my_shared_ptr|std::shared_ptr"
+	"hash_map|hash_map_operations|my_hash_map|std::unordered_map"
+	"string|string_operations|my_string|std::string"
+	"function|function_operations|my_function|std::function"
+	"optional|optional_operations|my_optional|std::optional"
+	"variant|variant_operations|my_variant|std::variant"
+	"atomic_shared_ptr|atomic_shared_ptr_operations|my_atomic_shared_ptr|compile_cost::StdAtomicSharedPtr"
+	"intrusive_ptr|intrusive_ptr_operations|my_intrusive_ptr|std::shared_ptr"
+	"spsc_queue|queue_operations|my_spsc_queue|compile_cost::LockedQueue"
+	"mpmc_queue|queue_operations|my_mpmc_queue|compile_cost::LockedQueue"
+	"concurrent_map|concurrent_map_operations|my_concurrent_map|compile_cost::LockedMap"
+)
+
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+
+# "1.25" seconds to 1250 milliseconds
+function(seconds_to_ms seconds out)
+	if(NOT seconds MATCHES "^([0-9]+)\\.?([0-9]*)$")
+		set(${out} 0 PARENT_SCOPE)
+		return()
+	endif()
+
+	set(whole ${CMAKE_MATCH_1})
+	string(SUBSTRING "${CMAKE_MATCH_2}000" 0 3 fraction)
+	string(REGEX REPLACE "^0+([0-9])" "\\1" fraction "${fraction}")
+	math(EXPR ms "${whole} * 1000 + ${fraction}")
+	set(${out} ${ms} PARENT_SCOPE)
+endfunction()
+
+# Wall time of a phase in GCC's -ftime-report, whose columns are user, system and wall
+function(gcc_phase_ms report phase out)
+	set(time "[0-9.]+ *\\( *[0-9]+%\\)")
+	if(report MATCHES "phase ${phase} *: *${time} *${time} *([0-9.]+)")
+		seconds_to_ms(${CMAKE_MATCH_1} ms)
+		set(${out} ${ms} PARENT_SCOPE)
+	else()
+		set(${out} 0 PARENT_SCOPE)
+	endif()
+endfunction()
+
+# Duration of one of the totals in Clang's -ftime-trace, which are in microseconds
+function(clang_total_ms trace name out)
+	if(trace MATCHES "\"dur\":([0-9]+),\"name\":\"${name}\"")
+		math(EXPR ms "${CMAKE_MATCH_1} / 1000")
+		set(${out} ${ms} PARENT_SCOPE)
+	else()
+		set(${out} 0 PARENT_SCOPE)
+	endif()
+endfunction()
+
+# Sets <name>_frontend and <name>_backend in milliseconds, the fastest of REPEATS compiles, and <name>_size in bytes
+function(compile_unit name content)
+	set(source "${OUTPUT_DIR}/${name}.cpp")
+	set(object "${OUTPUT_DIR}/${name}.o")
+	file(WRITE "${source}" "${content}")
+
+	if(COMPILER_ID MATCHES "Clang")
+		set(timing -ftime-trace)
+	else()
+		set(timing -ftime-report)
+	endif()
+
+	set(best_frontend "")
+	set(best_backend "")
+	foreach(run RANGE 1 ${REPEATS})
+		execute_process(
+			COMMAND ${COMPILER} ${STANDARD} ${options} ${definitions} -I${SOURCE_DIR}/src ${timing} -c ${source} -o ${object}
+			RESULT_VARIABLE result
+			OUTPUT_QUIET
+			ERROR_VARIABLE report
+		)
+		if(NOT result EQUAL 0)
+			message(FATAL_ERROR "Compiling ${source} failed:\n${report}")
+		endif()
+
+		if(COMPILER_ID MATCHES "Clang")
+			file(READ "${OUTPUT_DIR}/${name}.json" trace)
+			clang_total_ms("${trace}" "Total Frontend" frontend)
+			clang_total_ms("${trace}" "Total Backend" backend)
+		else()
+			gcc_phase_ms("${report}" "setup" setup)
+			gcc_phase_ms("${report}" "parsing" parsing)
+			gcc_phase_ms("${report}" "lang\\. deferred" deferred)
+			gcc_phase_ms("${report}" "opt and generate" generate)
+			gcc_phase_ms("${report}" "last asm" last_asm)
+			gcc_phase_ms("${report}" "finalize" finalize)
+			math(EXPR frontend "${setup} + ${parsing} + ${deferred}")
+			math(EXPR backend "${generate} + ${last_asm} + ${finalize}")
+		endif()
+
+		if(best_frontend STREQUAL "" OR frontend LESS best_frontend)
+			set(best_frontend ${frontend})
+		endif()
+		if(best_backend STREQUAL "" OR backend LESS best_backend)
+			set(best_backend ${backend})
+		endif()
+	endforeach()
+
+	file(SIZE "${object}" size)
+
+	set(${name}_frontend ${best_frontend} PARENT_SCOPE)
+	set(${name}_backend ${best_backend} PARENT_SCOPE)
+	set(${name}_size ${size} PARENT_SCOPE)
+endfunction()
+
+# Formats the difference from the headers only unit, which can come out slightly negative for times
+function(format_seconds ms baseline out)
+	math(EXPR ms "${ms} - ${baseline}")
+	if(ms LESS 0)
+		set(ms 0)
+	endif()
+	math(EXPR whole "${ms} / 1000")
+	math(EXPR hundredths "(${ms} % 1000) / 10")
+	if(hundredths LESS 10)
+		set(hundredths "0${hundredths}")
+	endif()
+	set(${out} "${whole}.${hundredths} s" PARENT_SCOPE)
+endfunction()
+
+function(format_kb bytes baseline out)
+	math(EXPR bytes "${bytes} - ${baseline}")
+	if(bytes LESS 0)
+		set(bytes 0)
+	endif()
+	math(EXPR tenths "${bytes} * 10 / 1024")
+	math(EXPR whole "${tenths} / 10")
+	math(EXPR tenths "${tenths} % 10")
+	set(${out} "${whole}.${tenths} KB" PARENT_SCOPE)
+endfunction()
+
+function(pad text width out)
+	string(LENGTH "${text}" length)
+	while(length LESS width)
+		string(PREPEND text " ")
+		math(EXPR length "${length} + 1")
+	endwhile()
+	set(${out} "${text}" PARENT_SCOPE)
+endfunction()
+
+# counted_malloc.h is included as in the harness, where the candidates' malloc calls are redirected to it
+set(prologue "// Generated by compile_cost.cmake\n#include \"compile_cost.h\"\n#include \"counted_malloc.h\"\n#include \"candidates.h\"\n\n")
+compile_unit(headers "${prologue}")
+
+format_seconds(${headers_frontend} 0 frontend)
+format_seconds(${headers_backend} 0 backend)
+format_kb(${headers_size} 0 size)
+message("\nCompile cost, ${TYPES} element types and ${OPERATIONS} operations, fastest of ${REPEATS} compiles, over a unit only including the headers")
+message("  (${frontend} frontend, ${backend} backend, ${size})\n")
+message("                   frontend    backend      object    std frontend    std backend    std object")
+
+foreach(entry IN LISTS containers)
+	string(REPLACE "|" ";" container "${entry}")
+	list(GET container 0 suite)
+	list(GET container 1 function)
+
+	foreach(implementation candidate std)
+		if(implementation STREQUAL "candidate")
+			list(GET container 2 type)
+		else()
+			list(GET container 3 type)
+		endif()
+
+		set(content "${prologue}")
+		if(suite STREQUAL "string")
+			string(APPEND content "template void compile_cost::${function}<${type}, ${OPERATIONS}>();\n")
+		else()
+			math(EXPR last_type "${TYPES} - 1")
+			foreach(index RANGE ${last_type})
+				string(APPEND content "template void compile_cost::${function}<${type}, compile_cost::Item<${index}>, ${OPERATIONS}>();\n")
+			endforeach()
+		endif()
+
+		compile_unit(${suite}_${implementation} "${content}")
+	endforeach()
+
+	set(columns "")
+	foreach(implementation candidate std)
+		format_seconds(${${suite}_${implementation}_frontend} ${headers_frontend} frontend)
+		format_seconds(${${suite}_${implementation}_backend} ${headers_backend} backend)
+		format_kb(${${suite}_${implementation}_size} ${headers_size} size)
+
+		if(implementation STREQUAL "candidate")
+			set(widths 10 11 12)
+		else()
+			set(widths 16 15 14)
+		endif()
+		list(GET widths 0 frontend_width)
+		list(GET widths 1 backend_width)
+		list(GET widths 2 size_width)
+
+		pad("${frontend}" ${frontend_width} frontend)
+		pad("${backend}" ${backend_width} backend)
+		pad("${size}" ${size_width} size)
+		string(APPEND columns "${frontend}${backend}${size}")
+	endforeach()
+
+	string(LENGTH "${suite}" length)
+	set(name "  ${suite}")
+	while(length LESS 17)
+		string(APPEND name " ")
+		math(EXPR length "${length} + 1")
+	endwhile()
+	message("${name}${columns}")
+endforeach()
+
+message("")
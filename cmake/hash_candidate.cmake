@@ -0,0 +1,58 @@
+# Writes the SHA-256 of each suite's preprocessed source to a source file, which keys the result cache. A suite's
+# source is its tests_<suite>.h, along with the harness headers that includes, followed by candidates.h, so a change
+# to one suite's tests only reruns that suite. main.cpp, which picks the candidates each suite is run with, is
+# hashed in with every suite. The file is only rewritten when a hash changes, so unchanged candidates don't relink.
+#
+# Expects COMPILER, STANDARD, SOURCE_DIR and OUTPUT, and DEFINITIONS and OPTIONS as |-separated lists.
+
+string(REPLACE "|" ";" definitions "${DEFINITIONS}")
+string(REPLACE "|" ";" options "${OPTIONS}")
+list(TRANSFORM definitions PREPEND "-D")
+
+get_filename_component(work_dir "${OUTPUT}" DIRECTORY)
+set(work_dir "${work_dir}/candidate_hash")
+file(MAKE_DIRECTORY "${work_dir}")
+
+file(GLOB suite_headers "${SOURCE_DIR}/src/tests_*.h")
+list(REMOVE_ITEM suite_headers "${SOURCE_DIR}/src/tests_common.h")
+list(SORT suite_headers)
+
+# The suites are preprocessed together as the commands of one pipeline. Each writes to its own file rather than to
+# stdout, so nothing flows between them and they just run in parallel.
+set(suites "")
+set(commands "")
+foreach(header ${suite_headers})
+	get_filename_component(header_name "${header}" NAME_WE)
+	string(REGEX REPLACE "^tests_" "" suite "${header_name}")
+	list(APPEND suites ${suite})
+
+	file(WRITE "${work_dir}/${suite}.cpp" "#include \"${header_name}.h\"\n#include \"candidates.h\"\n")
+	list(APPEND commands COMMAND ${COMPILER} ${STANDARD} ${options} ${definitions} -I${SOURCE_DIR}/src -E -P
+		${work_dir}/${suite}.cpp -o ${work_dir}/${suite}.i)
+endforeach()
+
+execute_process(${commands} RESULTS_VARIABLE results)
+foreach(result ${results})
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "Preprocessing the suites for the result cache failed")
+	endif()
+endforeach()
+
+file(SHA256 "${SOURCE_DIR}/src/main.cpp" main_hash)
+
+set(content "#include <cstring>\n\n// Null for a suite that has no tests_<suite>.h to hash\nconst char* candidate_source_hash(const char* suite)\n{\n")
+foreach(suite ${suites})
+	file(SHA256 "${work_dir}/${suite}.i" suite_hash)
+	string(SHA256 hash "${main_hash}${suite_hash}")
+	string(APPEND content "\tif (strcmp(suite, \"${suite}\") == 0)\n\t\treturn \"${hash}\";\n")
+endforeach()
+string(APPEND content "\treturn nullptr;\n}\n")
+
+set(previous "")
+if(EXISTS "${OUTPUT}")
+	file(READ "${OUTPUT}" previous)
+endif()
+
+if(NOT content STREQUAL previous)
+	file(WRITE "${OUTPUT}" "${content}")
+endif()
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "harness_options.h"
+#include "result_cache.h"
+
+// Number of timed samples taken by benchmark_ns, the median of which is reported
+constexpr int benchmark_samples = 15;
+
+// Stops the optimiser from discarding a value that is computed but never used
+template <typename T>
+void do_not_optimize(T&& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile char sink;
+	sink = *reinterpret_cast<volatile const char*>(&value);
+#endif
+}
+
+// Hides a value from the optimiser, so loops bounded by it can't be specialised for a compile time constant
+template <typename T>
+void make_opaque(T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : "+m"(value) : : "memory");
+#else
+	volatile T copy = value;
+	value = copy;
+#endif
+}
+
+// Times func over a number of samples and returns the median in nanoseconds
+template <typename F>
+double benchmark_ns(F&& func)
+{
+	double samples[benchmark_samples];
+
+	for (int i = 0; i < harness_options.warmup; i++)
+		func();
+
+	for (int i = 0; i < benchmark_samples; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		func();
+		auto end = std::chrono::steady_clock::now();
+
+		samples[i] = std::chrono::duration<double, std::nano>(end - start).count();
+	}
+
+	std::nth_element(samples, samples + benchmark_samples / 2, samples + benchmark_samples);
+	return samples[benchmark_samples / 2];
+}
+
+// Reads the time stamp counter where there is one, falling back to nanoseconds elsewhere
+uint64_t read_cycle_counter()
+{
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	return __builtin_ia32_rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Same as benchmark_ns, but measured in cycles of the time stamp counter
+template <typename F>
+double benchmark_cycles(F&& func)
+{
+	double samples[benchmark_samples];
+
+	for (int i = 0; i < harness_options.warmup; i++)
+		func();
+
+	for (int i = 0; i < benchmark_samples; i++)
+	{
+		auto start = read_cycle_counter();
+		func();
+		auto end = read_cycle_counter();
+
+		samples[i] = double(end - start);
+	}
+
+	std::nth_element(samples, samples + benchmark_samples / 2, samples + benchmark_samples);
+	return samples[benchmark_samples / 2];
+}
+
+// Latency histograms split every power of two into 2^(latency_sub_bucket_bits - 1) linear buckets, as HdrHistogram
+// does, so any recorded value is reported to within about 3% whether it's 20 cycles or 20 billion
+constexpr int latency_sub_bucket_bits = 6;
+constexpr int latency_sub_buckets = 1 << latency_sub_bucket_bits;
+constexpr int latency_half_sub_buckets = latency_sub_buckets / 2;
+constexpr int latency_bucket_count = (64 - latency_sub_bucket_bits + 2) * latency_half_sub_buckets;
+
+// Samples more than this many times the median are reported one by one along with the index they were recorded at
+constexpr uint64_t latency_spike_factor = 10;
+
+struct LatencyHistogram
+{
+	uint64_t counts[latency_bucket_count] = {};
+	uint64_t total = 0;
+	uint64_t max = 0;
+
+	static int bucket_index(uint64_t value)
+	{
+		if (value < latency_sub_buckets)
+			return int(value);
+
+		int shift = int(std::bit_width(value)) - latency_sub_bucket_bits;
+		return shift * latency_half_sub_buckets + int(value >> shift);
+	}
+
+	// Smallest value that falls in the bucket
+	static uint64_t bucket_value(int index)
+	{
+		if (index < latency_sub_buckets)
+			return uint64_t(index);
+
+		int shift = index / latency_half_sub_buckets - 1;
+		return uint64_t(index - shift * latency_half_sub_buckets) << shift;
+	}
+
+	void record(uint64_t value)
+	{
+		counts[bucket_index(value)] += 1;
+		total += 1;
+		max = std::max(max, value);
+	}
+
+	// Adds the samples of a histogram filled by another thread
+	void merge(const LatencyHistogram& other)
+	{
+		for (int i = 0; i < latency_bucket_count; i++)
+			counts[i] += other.counts[i];
+		total += other.total;
+		max = std::max(max, other.max);
+	}
+
+	// Value below which the given fraction of samples fall, to the precision of the buckets
+	uint64_t percentile(double fraction) const
+	{
+		uint64_t target = std::max<uint64_t>(1, uint64_t(fraction * double(total) + 0.5));
+		uint64_t seen = 0;
+
+		for (int i = 0; i < latency_bucket_count; i++)
+		{
+			seen += counts[i];
+			if (seen >= target)
+				return std::min(bucket_value(i), max);
+		}
+
+		return max;
+	}
+};
+
+// Times each call of func(i) for i in [0, count) separately with the cycle counter. The counter isn't serialising,
+// so single samples are only good to a few tens of cycles, but that's well below the spikes this is meant to find.
+// Every sample is kept in samples, which is sized before the first call so filling it doesn't add faults of its own.
+template <typename F>
+void record_latencies(LatencyHistogram& histogram, std::vector<uint64_t>& samples, size_t count, F&& func)
+{
+	samples.assign(count, 0);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		auto start = read_cycle_counter();
+		func(i);
+		auto end = read_cycle_counter();
+
+		samples[i] = end - start;
+	}
+
+	for (uint64_t sample : samples)
+		histogram.record(sample);
+}
+
+// Resident set size of the process in bytes, from /proc/self/statm, or 0 where that isn't available
+size_t read_rss_bytes()
+{
+#ifdef __linux__
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm == nullptr)
+		return 0;
+
+	unsigned long size_pages = 0;
+	unsigned long resident_pages = 0;
+	int fields = fscanf(statm, "%lu %lu", &size_pages, &resident_pages);
+	fclose(statm);
+
+	if (fields != 2)
+		return 0;
+
+	return size_t(resident_pages) * size_t(sysconf(_SC_PAGESIZE));
+#else
+	return 0;
+#endif
+}
+
+// Benchmark results are kept so runs on different allocators can be compared at the end
+struct BenchmarkRecord
+{
+	const char* suite;
+	const char* allocator;
+	char name[96];
+	double value;
+	char unit[24];
+};
+
+constexpr int benchmark_max_records = 4096;
+
+BenchmarkRecord benchmark_records[benchmark_max_records];
+int benchmark_record_count = 0;
+
+// Rates are better higher, everything else is a time or a cost
+bool benchmark_higher_is_better(const char* unit)
+{
+	return strstr(unit, "/s") != nullptr || strstr(unit, "/cycle") != nullptr;
+}
+
+void record_benchmark(const char* name, double value, const char* unit)
+{
+	char payload[64];
+	snprintf(payload, sizeof(payload), "%.17g\t%s", value, unit);
+	result_cache_add("benchmark", name, payload);
+
+	if (harness_options.format == OutputFormat::Json)
+	{
+		output_json_line_start("benchmark", name);
+		fprintf(json_output, ", \"value\": %g, \"unit\": ", value);
+		output_json_string(unit);
+		fprintf(json_output, "}\n");
+	}
+
+	if (benchmark_record_count == benchmark_max_records)
+		return;
+
+	BenchmarkRecord& record = benchmark_records[benchmark_record_count++];
+	record.suite = current_suite;
+	record.allocator = current_allocator;
+	snprintf(record.name, sizeof(record.name), "%s", name);
+	record.value = value;
+	snprintf(record.unit, sizeof(record.unit), "%s", unit);
+}
+
+void output_benchmark(const char* name, double value, const char* unit)
+{
+	printf("  %s: %.2f %s\n", name, value, unit);
+	record_benchmark(name, value, unit);
+}
+
+void output_benchmark_comparison(const char* name, double value_ns, const char* baseline_name, double baseline_ns)
+{
+	printf("  %s: %.0f ns (%s: %.0f ns, %.2fx)\n", name, value_ns, baseline_name, baseline_ns, baseline_ns / value_ns);
+	record_benchmark(name, value_ns, "ns");
+}
+
+// Every recorded workload with its result on each allocator it was run on, and which allocator did best
+void output_allocator_report()
+{
+	printf("\nAllocator report\n-------------------------------\n");
+
+	for (int i = 0; i < benchmark_record_count; i++)
+	{
+		const BenchmarkRecord& first = benchmark_records[i];
+		auto same_workload = [&](const BenchmarkRecord& record) {
+			return strcmp(record.suite, first.suite) == 0 && strcmp(record.name, first.name) == 0;
+		};
+
+		if (std::any_of(benchmark_records, benchmark_records + i, same_workload))
+			continue;
+
+		const BenchmarkRecord* best = &first;
+		printf("  %s, %s (%s):", first.suite, first.name, first.unit);
+
+		for (int j = i; j < benchmark_record_count; j++)
+		{
+			const BenchmarkRecord& record = benchmark_records[j];
+			if (!same_workload(record))
+				continue;
+
+			printf(" %s %.2f", record.allocator, record.value);
+
+			bool better = benchmark_higher_is_better(record.unit) ? record.value > best->value : record.value < best->value;
+			if (better)
+				best = &record;
+		}
+
+		printf(", best: \033[32m%s\033[0m\n", best->allocator);
+	}
+
+	if (benchmark_record_count == benchmark_max_records)
+		printf("  results past the first %d weren't recorded\n", benchmark_max_records);
+}
+
+void output_latency(const char* name, const LatencyHistogram& histogram)
+{
+	printf("  %s: p50 %llu, p99 %llu, p99.9 %llu, max %llu cycles\n", name,
+		(unsigned long long)histogram.percentile(0.5), (unsigned long long)histogram.percentile(0.99),
+		(unsigned long long)histogram.percentile(0.999), (unsigned long long)histogram.max);
+}
+
+// Every sample above latency_spike_factor times the median, in the order they were recorded
+void output_latency_spikes(const char* name, const LatencyHistogram& histogram, const std::vector<uint64_t>& samples)
+{
+	uint64_t threshold = std::max<uint64_t>(histogram.percentile(0.5), 1) * latency_spike_factor;
+	size_t count = size_t(std::count_if(samples.begin(), samples.end(), [&](uint64_t sample) { return sample > threshold; }));
+
+	printf("  %s (%zu above %llu cycles):", name, count, (unsigned long long)threshold);
+	bool first = true;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		if (samples[i] <= threshold)
+			continue;
+
+		printf("%s %zu (%llu cycles)", first ? "" : ",", i, (unsigned long long)samples[i]);
+		first = false;
+	}
+	printf("\n");
+}
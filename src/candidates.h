@@ -0,0 +1,93 @@
+#pragma once
+
+// The implementations under test, included by main.cpp after the harness headers and on their own by the
+// compile cost benchmark, so they should include whatever they use
+
+template <typename T>
+struct my_vector
+{
+
+};
+
+template <typename T>
+struct my_unique_ptr
+{
+
+};
+
+template <typename T>
+struct my_shared_ptr
+{
+
+};
+
+template <typename T>
+struct my_enable_shared_from_this
+{
+
+};
+
+template <typename T>
+struct my_atomic_shared_ptr
+{
+
+};
+
+template <typename T>
+struct my_intrusive_ptr
+{
+
+};
+
+template <typename T>
+struct my_deque
+{
+
+};
+
+template <typename K, typename V>
+struct my_hash_map
+{
+
+};
+
+struct my_string
+{
+
+};
+
+template <typename Signature>
+struct my_function
+{
+
+};
+
+template <typename T>
+struct my_optional
+{
+
+};
+
+template <typename... Ts>
+struct my_variant
+{
+
+};
+
+template <typename T>
+struct my_spsc_queue
+{
+
+};
+
+template <typename T>
+struct my_mpmc_queue
+{
+
+};
+
+template <typename K, typename V>
+struct my_concurrent_map
+{
+
+};
@@ -0,0 +1,386 @@
+#pragma once
+
+// Operations instantiated by the compile cost benchmark, which cmake/compile_cost.cmake explicitly instantiates for
+// each candidate and its std counterpart over a number of element types. Operations is how many of each list are
+// used, in order, and ones a type doesn't have are skipped, so candidates missing parts still build. Lists for
+// candidates with smaller interfaces are shorter than 8. The std headers are included for both, so the two only
+// differ in what gets instantiated.
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <string>
+#include <functional>
+#include <optional>
+#include <variant>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+namespace compile_cost
+{
+
+// Element types, each a distinct instantiation of a different size
+template <int I>
+struct Item
+{
+	int id = I;
+	char payload[I % 8 + 1] = {};
+
+	bool operator==(const Item&) const = default;
+};
+
+// Keeps what's built from being optimised away, so the backend does the work it would in real use
+template <typename T>
+void keep(T& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Element types for intrusive pointers, which carry their own count
+template <typename T>
+struct RefCounted : T
+{
+	std::atomic<long> references = 0;
+
+	friend void intrusive_ptr_add_ref(RefCounted* p) { p->references += 1; }
+	friend void intrusive_ptr_release(RefCounted* p) { if (--p->references == 0) delete p; }
+};
+
+// std has no atomic shared pointer before C++20's specialisation, which not every standard library has yet, so
+// without it there's nothing to instantiate and the std columns come out empty
+#ifdef __cpp_lib_atomic_shared_ptr
+template <typename T>
+using StdAtomicSharedPtr = std::atomic<std::shared_ptr<T>>;
+#else
+template <typename T>
+struct StdAtomicSharedPtr {};
+#endif
+
+// std has no concurrent queue or map, so the counterparts are std containers behind a lock, as in the suites'
+// baselines
+template <typename T>
+class LockedQueue
+{
+public:
+	explicit LockedQueue(size_t capacity) : capacity(capacity) {}
+
+	bool try_push(T&& value)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (items.size() >= capacity)
+			return false;
+
+		items.push_back(std::move(value));
+		return true;
+	}
+
+	bool try_pop(T& value)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (items.empty())
+			return false;
+
+		value = std::move(items.front());
+		items.pop_front();
+		return true;
+	}
+
+private:
+	std::mutex mutex;
+	std::deque<T> items;
+	size_t capacity;
+};
+
+template <typename K, typename V>
+class LockedMap
+{
+public:
+	bool insert(K key, V value)
+	{
+		std::unique_lock lock(mutex);
+		return map.emplace(std::move(key), std::move(value)).second;
+	}
+
+	bool find(const K& key, V& value)
+	{
+		std::shared_lock lock(mutex);
+		auto found = map.find(key);
+		if (found == map.end())
+			return false;
+
+		value = found->second;
+		return true;
+	}
+
+	bool erase(const K& key)
+	{
+		std::unique_lock lock(mutex);
+		return map.erase(key) != 0;
+	}
+
+	template <typename F>
+	bool update(const K& key, F func)
+	{
+		std::unique_lock lock(mutex);
+		auto found = map.find(key);
+		if (found == map.end())
+			return false;
+
+		func(found->second);
+		return true;
+	}
+
+private:
+	std::shared_mutex mutex;
+	std::unordered_map<K, V> map;
+};
+
+template <template <typename> class Vec, typename T, int Operations>
+void vector_operations()
+{
+	Vec<T> v;
+	T item{};
+
+	if constexpr (Operations > 0 && requires { v.push_back(item); }) v.push_back(item);
+	if constexpr (Operations > 1 && requires { v.emplace_back(item); }) v.emplace_back(item);
+	if constexpr (Operations > 2 && requires { v.size(); }) { auto size = v.size(); keep(size); }
+	if constexpr (Operations > 3 && requires { v[0]; }) keep(v[0]);
+	if constexpr (Operations > 4 && requires { Vec<T>(v); }) { Vec<T> copy(v); keep(copy); }
+	if constexpr (Operations > 5 && requires { v.resize(42); }) v.resize(42);
+	if constexpr (Operations > 6 && requires { v.begin(); v.end(); }) for (auto& element : v) keep(element);
+	if constexpr (Operations > 7 && requires { v.clear(); }) v.clear();
+
+	keep(v);
+}
+
+template <template <typename> class Deq, typename T, int Operations>
+void deque_operations()
+{
+	Deq<T> d;
+	T item{};
+
+	if constexpr (Operations > 0 && requires { d.push_back(item); }) d.push_back(item);
+	if constexpr (Operations > 1 && requires { d.push_front(item); }) d.push_front(item);
+	if constexpr (Operations > 2 && requires { d.size(); }) { auto size = d.size(); keep(size); }
+	if constexpr (Operations > 3 && requires { d[0]; }) keep(d[0]);
+	if constexpr (Operations > 4 && requires { d.front(); d.back(); }) { keep(d.front()); keep(d.back()); }
+	if constexpr (Operations > 5 && requires { Deq<T>(d); }) { Deq<T> copy(d); keep(copy); }
+	if constexpr (Operations > 6 && requires { d.pop_back(); }) d.pop_back();
+	if constexpr (Operations > 7 && requires { d.pop_front(); }) d.pop_front();
+
+	keep(d);
+}
+
+template <template <typename> class UniquePtr, typename T, int Operations>
+void unique_ptr_operations()
+{
+	UniquePtr<T> p{};
+
+	if constexpr (Operations > 0 && requires { p.reset(new T()); }) p.reset(new T());
+	if constexpr (Operations > 1 && requires { *p; }) keep(*p);
+	if constexpr (Operations > 2 && requires { p.get(); }) { auto raw = p.get(); keep(raw); }
+	if constexpr (Operations > 3 && requires { UniquePtr<T>(std::move(p)); }) { UniquePtr<T> moved(std::move(p)); p = std::move(moved); }
+	if constexpr (Operations > 4 && requires { UniquePtr<T>(new T()); }) { UniquePtr<T> other(new T()); keep(other); }
+	if constexpr (Operations > 5 && requires { p.release(); }) delete p.release();
+	if constexpr (Operations > 6 && requires { p.reset(); }) p.reset();
+	if constexpr (Operations > 7 && requires { p->id; p.get(); }) if (p.get() != nullptr) keep(p->id);
+
+	keep(p);
+}
+
+template <template <typename> class SharedPtr, typename T, int Operations>
+void shared_ptr_operations()
+{
+	SharedPtr<T> p{};
+
+	if constexpr (Operations > 0 && requires { p.reset(new T()); }) p.reset(new T());
+	if constexpr (Operations > 1 && requires { *p; }) keep(*p);
+	if constexpr (Operations > 2 && requires { SharedPtr<T>(p); }) { SharedPtr<T> copy(p); keep(copy); }
+	if constexpr (Operations > 3 && requires { p.use_count(); }) { auto count = p.use_count(); keep(count); }
+	if constexpr (Operations > 4 && requires { p.get(); }) { auto raw = p.get(); keep(raw); }
+	if constexpr (Operations > 5 && requires { p = p; }) { SharedPtr<T> other{}; other = p; keep(other); }
+	if constexpr (Operations > 6 && requires { SharedPtr<T>(std::move(p)); }) { SharedPtr<T> moved(std::move(p)); p = std::move(moved); }
+	if constexpr (Operations > 7 && requires { p.reset(); }) p.reset();
+
+	keep(p);
+}
+
+// Candidates insert with (key, value), std::unordered_map with a pair
+template <template <typename, typename> class Map, typename T, int Operations>
+void hash_map_operations()
+{
+	Map<int, T> m;
+	T item{};
+
+	if constexpr (Operations > 0 && requires { m.insert(1, item); }) m.insert(1, item);
+	else if constexpr (Operations > 0 && requires { m.insert({ 1, item }); }) m.insert({ 1, item });
+	if constexpr (Operations > 1 && requires { m.find(1); }) { auto found = m.find(1); keep(found); }
+	if constexpr (Operations > 2 && requires { m.size(); }) { auto size = m.size(); keep(size); }
+	if constexpr (Operations > 3 && requires { m.rehash(size_t{ 64 }); }) m.rehash(size_t{ 64 });
+	if constexpr (Operations > 4 && requires { Map<int, T>(m); }) { Map<int, T> copy(m); keep(copy); }
+	if constexpr (Operations > 5 && requires { Map<int, T>(std::move(m)); }) { Map<int, T> moved(std::move(m)); m = std::move(moved); }
+	if constexpr (Operations > 6 && requires { m.erase(1); }) { auto erased = m.erase(1); keep(erased); }
+	if constexpr (Operations > 7 && requires { m.capacity(); }) { auto capacity = m.capacity(); keep(capacity); }
+
+	keep(m);
+}
+
+// Strings have no element type, so are only instantiated once
+template <typename String, int Operations>
+void string_operations()
+{
+	String s{};
+
+	if constexpr (Operations > 0 && requires { String("compile cost"); }) s = String("compile cost");
+	if constexpr (Operations > 1 && requires { s.size(); }) { auto size = s.size(); keep(size); }
+	if constexpr (Operations > 2 && requires { s.c_str(); }) { auto cstr = s.c_str(); keep(cstr); }
+	if constexpr (Operations > 3 && requires { s[0]; }) keep(s[0]);
+	if constexpr (Operations > 4 && requires { s += "benchmark"; }) s += "benchmark";
+	if constexpr (Operations > 5 && requires { s + s; }) { String joined = s + s; keep(joined); }
+	if constexpr (Operations > 6 && requires { String(s); }) { String copy(s); keep(copy); }
+	if constexpr (Operations > 7 && requires { s.capacity(); }) { auto capacity = s.capacity(); keep(capacity); }
+
+	keep(s);
+}
+
+template <template <typename> class Function, typename T, int Operations>
+void function_operations()
+{
+	using Func = Function<int(const T&)>;
+	Func f{};
+	T item{};
+
+	if constexpr (Operations > 0 && requires { f = [](const T& t) { return t.id; }; }) f = [](const T& t) { return t.id; };
+	if constexpr (Operations > 1 && requires { static_cast<bool>(f); }) { bool set = static_cast<bool>(f); keep(set); }
+	if constexpr (Operations > 2 && requires { f(item); static_cast<bool>(f); }) if (static_cast<bool>(f)) { int result = f(item); keep(result); }
+	if constexpr (Operations > 3 && requires { Func(f); }) { Func copy(f); keep(copy); }
+	if constexpr (Operations > 4 && requires { Func(std::move(f)); }) { Func moved(std::move(f)); f = std::move(moved); }
+	if constexpr (Operations > 5 && requires { f = [item](const T& t) { return t.id + item.id; }; }) f = [item](const T& t) { return t.id + item.id; };
+	if constexpr (Operations > 6 && requires { Func([](const T& t) { return t.id * 2; }); }) { Func other([](const T& t) { return t.id * 2; }); keep(other); }
+	if constexpr (Operations > 7 && requires { f = nullptr; }) f = nullptr;
+
+	keep(f);
+}
+
+template <template <typename> class Optional, typename T, int Operations>
+void optional_operations()
+{
+	Optional<T> o{};
+	T item{};
+
+	if constexpr (Operations > 0 && requires { o = item; }) o = item;
+	if constexpr (Operations > 1 && requires { o.has_value(); }) { bool has = o.has_value(); keep(has); }
+	if constexpr (Operations > 2 && requires { *o; o.has_value(); }) if (o.has_value()) keep(*o);
+	if constexpr (Operations > 3 && requires { Optional<T>(o); }) { Optional<T> copy(o); keep(copy); }
+	if constexpr (Operations > 4 && requires { Optional<T>(std::move(o)); }) { Optional<T> moved(std::move(o)); o = std::move(moved); }
+	if constexpr (Operations > 5 && requires { o.reset(); }) o.reset();
+	if constexpr (Operations > 6 && requires { o.emplace(); }) o.emplace();
+	if constexpr (Operations > 7 && requires { Optional<T>(item); }) { Optional<T> other(item); keep(other); }
+
+	keep(o);
+}
+
+// Candidates have member get, std::variant free std::get
+template <template <typename...> class Variant, typename T, int Operations>
+void variant_operations()
+{
+	Variant<int, T> v{};
+	T item{};
+
+	if constexpr (Operations > 0 && requires { v = item; }) v = item;
+	if constexpr (Operations > 1 && requires { v.index(); }) { auto index = v.index(); keep(index); }
+	if constexpr (Operations > 2 && requires { v.template get<T>(); }) keep(v.template get<T>());
+	else if constexpr (Operations > 2 && requires { std::get<T>(v); }) keep(std::get<T>(v));
+	if constexpr (Operations > 3 && requires { Variant<int, T>(v); }) { Variant<int, T> copy(v); keep(copy); }
+	if constexpr (Operations > 4 && requires { Variant<int, T>(std::move(v)); }) { Variant<int, T> moved(std::move(v)); v = std::move(moved); }
+	if constexpr (Operations > 5 && requires { v.template emplace<int>(0); }) v.template emplace<int>(0);
+	if constexpr (Operations > 6 && requires { v = 42; }) v = 42;
+	if constexpr (Operations > 7 && requires { Variant<int, T>(item); }) { Variant<int, T> other(item); keep(other); }
+
+	keep(v);
+}
+
+// The shared pointer type is whatever load returns, so the candidate's own is used without naming it
+template <template <typename> class AtomicSharedPtr, typename T, int Operations>
+void atomic_shared_ptr_operations()
+{
+	AtomicSharedPtr<T> a{};
+
+	if constexpr (requires { a.load(); })
+	{
+		using SP = decltype(a.load());
+		SP p{};
+
+		if constexpr (Operations > 0) { SP loaded = a.load(); keep(loaded); }
+		if constexpr (Operations > 1 && requires { a.store(p); }) a.store(p);
+		if constexpr (Operations > 2 && requires { a.exchange(p); }) { SP old = a.exchange(p); keep(old); }
+		if constexpr (Operations > 3 && requires { a.compare_exchange_strong(p, p); }) { SP expected = p; bool exchanged = a.compare_exchange_strong(expected, p); keep(exchanged); }
+		if constexpr (Operations > 4 && requires { a.compare_exchange_weak(p, p); }) { SP expected = p; bool exchanged = a.compare_exchange_weak(expected, p); keep(exchanged); }
+		if constexpr (Operations > 5 && requires { a.is_lock_free(); }) { bool lock_free = a.is_lock_free(); keep(lock_free); }
+		if constexpr (Operations > 6 && requires { a.load(std::memory_order_acquire); }) { SP loaded = a.load(std::memory_order_acquire); keep(loaded); }
+		if constexpr (Operations > 7 && requires { a.store(p, std::memory_order_release); }) a.store(p, std::memory_order_release);
+	}
+
+	keep(a);
+}
+
+// Instantiated over RefCounted elements, std::shared_ptr being the nearest std counterpart
+template <template <typename> class IntrusivePtr, typename T, int Operations>
+void intrusive_ptr_operations()
+{
+	using Element = RefCounted<T>;
+	IntrusivePtr<Element> p{};
+
+	if constexpr (Operations > 0 && requires { p.reset(new Element()); }) p.reset(new Element());
+	if constexpr (Operations > 1 && requires { *p; }) keep(*p);
+	if constexpr (Operations > 2 && requires { IntrusivePtr<Element>(p); }) { IntrusivePtr<Element> copy(p); keep(copy); }
+	if constexpr (Operations > 3 && requires { p.get(); }) { auto raw = p.get(); keep(raw); }
+	if constexpr (Operations > 4 && requires { p = p; }) { IntrusivePtr<Element> other{}; other = p; keep(other); }
+	if constexpr (Operations > 5 && requires { IntrusivePtr<Element>(std::move(p)); }) { IntrusivePtr<Element> moved(std::move(p)); p = std::move(moved); }
+	if constexpr (Operations > 6 && requires { IntrusivePtr<Element>(new Element()); }) { IntrusivePtr<Element> other(new Element()); keep(other); }
+	if constexpr (Operations > 7 && requires { p.reset(); }) p.reset();
+
+	keep(p);
+}
+
+// Used for both the SPSC and MPMC queues, which have the same interface
+template <template <typename> class Queue, typename T, int Operations>
+void queue_operations()
+{
+	if constexpr (requires { Queue<T>(size_t{ 16 }); })
+	{
+		Queue<T> q(16);
+		T item{};
+
+		if constexpr (Operations > 0 && requires { q.try_push(T(item)); }) { bool pushed = q.try_push(T(item)); keep(pushed); }
+		if constexpr (Operations > 1 && requires { q.try_pop(item); }) { bool popped = q.try_pop(item); keep(popped); }
+		if constexpr (Operations > 2 && requires { q.try_push(T(item)); }) while (q.try_push(T(item))) {}
+		if constexpr (Operations > 3 && requires { q.try_pop(item); }) while (q.try_pop(item)) {}
+		if constexpr (Operations > 4 && requires { q.try_push(std::move(item)); }) { bool pushed = q.try_push(std::move(item)); keep(pushed); }
+		if constexpr (Operations > 5) { Queue<T> other(1024); keep(other); }
+
+		keep(q);
+		keep(item);
+	}
+}
+
+template <template <typename, typename> class Map, typename T, int Operations>
+void concurrent_map_operations()
+{
+	Map<int, T> m;
+	T item{};
+
+	if constexpr (Operations > 0 && requires { m.insert(1, item); }) { bool inserted = m.insert(1, item); keep(inserted); }
+	if constexpr (Operations > 1 && requires { m.find(1, item); }) { bool found = m.find(1, item); keep(found); }
+	if constexpr (Operations > 2 && requires { m.erase(1); }) { bool erased = m.erase(1); keep(erased); }
+	if constexpr (Operations > 3 && requires { m.update(1, [](T& value) { value.id += 1; }); }) { bool updated = m.update(1, [](T& value) { value.id += 1; }); keep(updated); }
+
+	keep(m);
+	keep(item);
+}
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+// Number of threads the scaling benchmarks go up to
+int max_thread_count()
+{
+	int count = int(std::thread::hardware_concurrency());
+	return count > 0 ? count : 1;
+}
+
+// Thread counts for scaling benchmarks: powers of two up to, and including, every hardware thread
+std::vector<int> scaling_thread_counts()
+{
+	std::vector<int> counts;
+
+	for (int count = 1; count < max_thread_count(); count *= 2)
+		counts.push_back(count);
+	counts.push_back(max_thread_count());
+
+	return counts;
+}
+
+// Runs func(thread_index) on thread_count threads which are all released at once, and waits for them to finish
+template <typename F>
+void run_concurrently(int thread_count, F&& func)
+{
+	std::atomic<int> ready = 0;
+	std::atomic<bool> go = false;
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < thread_count; i++)
+	{
+		threads.emplace_back([&, i] {
+			ready += 1;
+			while (!go)
+				std::this_thread::yield();
+
+			func(i);
+		});
+	}
+
+	while (ready != thread_count)
+		std::this_thread::yield();
+	go = true;
+
+	for (auto& thread : threads)
+		thread.join();
+}
+
+// An operation recorded for the linearizability checker. call and ret are ticks of a HistoryClock taken either side
+// of it, so an operation that returned before another was called has to take effect before it.
+struct HistoryOperation
+{
+	int kind;
+	int64_t value;
+	bool success;
+	uint64_t call;
+	uint64_t ret;
+};
+
+struct HistoryClock
+{
+	std::atomic<uint64_t> ticks = 0;
+
+	uint64_t tick()
+	{
+		return ticks.fetch_add(1);
+	}
+};
+
+// Wing and Gong's search for an order of the operations, consistent with real time, in which a sequential model gives
+// each the result it had, with Lowe's memoisation of the linearised sets and model states already tried. Model needs
+// apply(op), returning whether op's result is possible, and operator<. Still exponential in the worst case, so only
+// for histories of a few dozen operations.
+template <typename Model>
+class LinearizabilityChecker
+{
+public:
+	LinearizabilityChecker(std::vector<HistoryOperation> operations) : history(std::move(operations)), linearized((history.size() + 63) / 64)
+	{
+		std::sort(history.begin(), history.end(), [](const HistoryOperation& a, const HistoryOperation& b) { return a.call < b.call; });
+	}
+
+	bool check(const Model& initial)
+	{
+		remaining = history.size();
+		return search(initial);
+	}
+
+private:
+	bool search(const Model& model)
+	{
+		if (remaining == 0)
+			return true;
+
+		// Only operations called before the first pending one returned can go next
+		uint64_t first_return = UINT64_MAX;
+		for (size_t i = 0; i < history.size(); i++)
+			if (!is_linearized(i))
+				first_return = std::min(first_return, history[i].ret);
+
+		for (size_t i = 0; i < history.size() && history[i].call < first_return; i++)
+		{
+			if (is_linearized(i))
+				continue;
+
+			Model next = model;
+			if (!next.apply(history[i]))
+				continue;
+
+			linearized[i / 64] ^= uint64_t(1) << (i % 64);
+
+			if (tried.insert({ linearized, next }).second)
+			{
+				remaining -= 1;
+				if (search(next))
+					return true;
+				remaining += 1;
+			}
+
+			linearized[i / 64] ^= uint64_t(1) << (i % 64);
+		}
+
+		return false;
+	}
+
+	bool is_linearized(size_t i) const
+	{
+		return (linearized[i / 64] >> (i % 64)) & 1;
+	}
+
+	std::vector<HistoryOperation> history;
+	std::vector<uint64_t> linearized;
+	std::set<std::pair<std::vector<uint64_t>, Model>> tried;
+	size_t remaining = 0;
+};
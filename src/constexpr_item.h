@@ -0,0 +1,92 @@
+#pragma once
+
+// Counterpart of MemoryCorrectnessItem for tests evaluated by the compiler. Constant evaluation has no statics to
+// count in, so counts go to a LifecycleCounts owned by the test, and no stale memory to keep tokens in, but doesn't
+// need any: reading a destroyed or uninitialised item, destroying one twice and leaving an allocation unfreed all
+// stop it being a constant expression.
+
+struct LifecycleCounts
+{
+	int constructed = 0;
+	int constructed_copy = 0;
+	int constructed_move = 0;
+	int assigned_copy = 0;
+	int assigned_move = 0;
+	int destroyed = 0;
+
+	// Copies and moves from an item that had been moved from
+	int errors_occurred = 0;
+
+	constexpr int count_alive() const
+	{
+		return constructed + constructed_copy + constructed_move - destroyed;
+	}
+};
+
+class ConstexprItem
+{
+public:
+	// Default constructed items, as made by resize, have no counts to go to. Assignment copies the id but not the
+	// counts, so an item is only counted if it was constructed from a counted one.
+	constexpr ConstexprItem() = default;
+
+	constexpr ConstexprItem(LifecycleCounts& counts, int id) : counts(&counts), id(id)
+	{
+		counts.constructed += 1;
+	}
+
+	constexpr ConstexprItem(const ConstexprItem& other) : counts(other.counts), id(other.id)
+	{
+		check_source(other);
+		if (counts != nullptr)
+			counts->constructed_copy += 1;
+	}
+
+	constexpr ConstexprItem(ConstexprItem&& other) noexcept : counts(other.counts), id(other.id)
+	{
+		check_source(other);
+		other.id = -1;
+		other.moved_from = true;
+		if (counts != nullptr)
+			counts->constructed_move += 1;
+	}
+
+	constexpr ConstexprItem& operator=(const ConstexprItem& other)
+	{
+		check_source(other);
+		id = other.id;
+		moved_from = false;
+		if (counts != nullptr)
+			counts->assigned_copy += 1;
+		return *this;
+	}
+
+	constexpr ConstexprItem& operator=(ConstexprItem&& other) noexcept
+	{
+		check_source(other);
+		id = other.id;
+		moved_from = false;
+		other.id = -1;
+		other.moved_from = true;
+		if (counts != nullptr)
+			counts->assigned_move += 1;
+		return *this;
+	}
+
+	constexpr ~ConstexprItem()
+	{
+		if (counts != nullptr)
+			counts->destroyed += 1;
+	}
+
+	LifecycleCounts* counts = nullptr;
+	int id = 0;
+	bool moved_from = false;
+
+private:
+	constexpr void check_source(const ConstexprItem& other)
+	{
+		if (other.moved_from && other.counts != nullptr)
+			other.counts->errors_occurred += 1;
+	}
+};
@@ -1,2 +1,7 @@
-size_t counted_malloc_allocations = 0;
-size_t counted_malloc_deallocations = 0;
\ No newline at end of file
+#include <cstddef>
+#include <atomic>
+
+std::atomic<size_t> counted_malloc_allocations = 0;
+std::atomic<size_t> counted_malloc_deallocations = 0;
+std::atomic<size_t> counted_malloc_bytes_allocated = 0;
+std::atomic<size_t> counted_malloc_bytes_deallocated = 0;
\ No newline at end of file
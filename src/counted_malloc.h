@@ -1,25 +1,215 @@
 #pragma once
 
-extern size_t counted_malloc_allocations;
-extern size_t counted_malloc_deallocations;
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#ifdef __GLIBC__
+// Declares malloc too, so has to come before the macros below like every other system header
+#include <malloc.h>
+#endif
 
-void* counted_malloc(size_t sz)
+#include "counted_malloc_backends.h"
+
+#ifdef TEST_HARNESS_ALLOCATION_PROFILER
+#include "counted_malloc_profiler.h"
+// Kept out of line, with the header bookkeeping inlined into them, so the profiler can skip a fixed number of
+// frames to reach the caller
+#define COUNTED_MALLOC_NOINLINE [[gnu::noinline]]
+#define COUNTED_MALLOC_ALWAYS_INLINE [[gnu::always_inline]] inline
+#else
+#define COUNTED_MALLOC_NOINLINE
+#define COUNTED_MALLOC_ALWAYS_INLINE
+#endif
+
+// Atomic for concurrent containers, and incremented relaxed as they're only read once the threads are joined
+extern std::atomic<size_t> counted_malloc_allocations;
+extern std::atomic<size_t> counted_malloc_deallocations;
+extern std::atomic<size_t> counted_malloc_bytes_allocated;
+extern std::atomic<size_t> counted_malloc_bytes_deallocated;
+
+// Every block is prefixed with its requested size, so frees can be counted in bytes as well, the backend it came
+// from, and the allocation site when profiling. The tag comes last, right below the pointer handed out, so a pointer
+// from something else, like strdup, aligned_alloc or getline, can be told apart by reading the 4 bytes below it. On
+// glibc those are the top half of the chunk's size, which is 0, so they never match.
+struct CountedMallocHeader
+{
+#ifdef TEST_HARNESS_ALLOCATION_PROFILER
+	uint32_t site;
+	uint16_t generation;
+#endif
+	alignas(alignof(std::max_align_t)) size_t size;
+	uint16_t backend;
+	uint32_t tag;
+};
+
+constexpr uint32_t counted_malloc_tag = 0xc0a1e5ce;
+constexpr size_t counted_malloc_header_size = sizeof(CountedMallocHeader);
+static_assert(counted_malloc_header_size % alignof(std::max_align_t) == 0);
+static_assert(offsetof(CountedMallocHeader, tag) == counted_malloc_header_size - sizeof(uint32_t));
+
+COUNTED_MALLOC_ALWAYS_INLINE void counted_malloc_record(CountedMallocHeader* header, size_t sz, int backend)
+{
+	header->size = sz;
+	header->backend = uint16_t(backend);
+	header->tag = counted_malloc_tag;
+#ifdef TEST_HARNESS_ALLOCATION_PROFILER
+	header->site = profiler_record_allocation(sz);
+	header->generation = uint16_t(profiler_generation);
+#endif
+}
+
+void counted_malloc_record_free([[maybe_unused]] CountedMallocHeader* header)
+{
+#ifdef TEST_HARNESS_ALLOCATION_PROFILER
+	profiler_record_free(header->site, header->generation, header->size);
+#endif
+}
+
+// Failed allocations, including sizes too big to add the header to, return null and aren't counted
+COUNTED_MALLOC_NOINLINE void* counted_malloc(size_t sz)
 {
-	counted_malloc_allocations += 1;
-	return malloc(sz);
+	if (sz > SIZE_MAX - counted_malloc_header_size)
+		return nullptr;
+
+	int backend = counted_malloc_backend;
+	char* block = (char*)allocator_backends[backend].allocate(sz + counted_malloc_header_size);
+	if (block == nullptr)
+		return nullptr;
+
+	counted_malloc_allocations.fetch_add(1, std::memory_order_relaxed);
+	counted_malloc_bytes_allocated.fetch_add(sz, std::memory_order_relaxed);
+
+	counted_malloc_record((CountedMallocHeader*)block, sz, backend);
+	return block + counted_malloc_header_size;
 }
 
+// Whether ptr came from counted_malloc, rather than from libc directly. Reads below a foreign block, into libc's
+// chunk header, which AddressSanitizer would report.
+[[gnu::no_sanitize_address]] bool counted_malloc_owns(void* ptr)
+{
+	return *(uint32_t*)((char*)ptr - sizeof(uint32_t)) == counted_malloc_tag;
+}
+
+// Blocks allocated elsewhere weren't counted, so they go straight back to libc without being counted either
 void counted_free(void* ptr)
 {
-	counted_malloc_deallocations += 1;
-	free(ptr);
+	if (ptr != nullptr && !counted_malloc_owns(ptr))
+	{
+		free(ptr);
+		return;
+	}
+
+	counted_malloc_deallocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (ptr == nullptr)
+		return;
+
+	// Cleared so the memory doesn't still look counted once the backend hands it out again
+	CountedMallocHeader* header = (CountedMallocHeader*)((char*)ptr - counted_malloc_header_size);
+	header->tag = 0;
+	counted_malloc_bytes_deallocated.fetch_add(header->size, std::memory_order_relaxed);
+	counted_malloc_record_free(header);
+	allocator_backends[header->backend].deallocate(header, header->size + counted_malloc_header_size);
+}
+
+void* counted_calloc(size_t count, size_t sz)
+{
+	if (sz != 0 && count > SIZE_MAX / sz)
+		return nullptr;
+
+	void* ptr = counted_malloc(count * sz);
+	if (ptr != nullptr)
+		memset(ptr, 0, count * sz);
+	return ptr;
+}
+
+COUNTED_MALLOC_NOINLINE void* counted_realloc(void* ptr, size_t sz)
+{
+	if (ptr == nullptr)
+		return counted_malloc(sz);
+
+	if (!counted_malloc_owns(ptr))
+		return realloc(ptr, sz);
+
+	if (sz > SIZE_MAX - counted_malloc_header_size)
+		return nullptr;
+
+	// Kept aside, as the old block may be gone by the time the free is recorded
+	CountedMallocHeader* header = (CountedMallocHeader*)((char*)ptr - counted_malloc_header_size);
+	CountedMallocHeader old_header = *header;
+	size_t old_sz = header->size;
+
+	// A block from another backend, from before a switch, moves over to the current one. On failure the old block
+	// is left as it was, as with realloc.
+	int backend = counted_malloc_backend;
+	char* block;
+	if (header->backend == backend)
+	{
+		block = (char*)allocator_backends[backend].reallocate(header, old_sz + counted_malloc_header_size, sz + counted_malloc_header_size);
+		if (block == nullptr)
+			return nullptr;
+	}
+	else
+	{
+		block = (char*)allocator_backends[backend].allocate(sz + counted_malloc_header_size);
+		if (block == nullptr)
+			return nullptr;
+		memcpy(block + counted_malloc_header_size, ptr, std::min(old_sz, sz));
+		allocator_backends[header->backend].deallocate(header, old_sz + counted_malloc_header_size);
+	}
+
+	// Counted as a fresh allocation and a free, which is what it costs when the block has to move
+	counted_malloc_allocations.fetch_add(1, std::memory_order_relaxed);
+	counted_malloc_deallocations.fetch_add(1, std::memory_order_relaxed);
+	counted_malloc_bytes_allocated.fetch_add(sz, std::memory_order_relaxed);
+	counted_malloc_bytes_deallocated.fetch_add(old_sz, std::memory_order_relaxed);
+
+	counted_malloc_record_free(&old_header);
+
+	counted_malloc_record((CountedMallocHeader*)block, sz, backend);
+	return block + counted_malloc_header_size;
+}
+
+size_t counted_malloc_bytes_live()
+{
+	return counted_malloc_bytes_allocated - counted_malloc_bytes_deallocated;
+}
+
+// What the libc heap holds, as opposed to what was asked of counted_malloc. Blocks the thread cache and slab
+// backends keep on their free lists count as in use here.
+struct HeapStats
+{
+	bool available;
+	size_t in_use;
+	size_t free;
+	size_t mapped;
+};
+
+HeapStats read_heap_stats()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+	return { true, info.uordblks + info.hblkhd, info.fordblks, info.hblkhd };
+#else
+	return { false, 0, 0, 0 };
+#endif
 }
 
 void counted_malloc_reset()
 {
 	counted_malloc_allocations = 0;
 	counted_malloc_deallocations = 0;
+	counted_malloc_bytes_allocated = 0;
+	counted_malloc_bytes_deallocated = 0;
+
+#ifdef TEST_HARNESS_ALLOCATION_PROFILER
+	profiler_reset();
+#endif
 }
 
 #define malloc(x) counted_malloc(x)
-#define free(x) counted_free(x)
\ No newline at end of file
+#define free(x) counted_free(x)
+#define calloc(x, y) counted_calloc(x, y)
+#define realloc(x, y) counted_realloc(x, y)
\ No newline at end of file
@@ -0,0 +1,416 @@
+#pragma once
+
+// Allocators counted_malloc can forward to, so the same candidates can be benchmarked on top of each of them.
+// Sizes passed in include the counted_malloc header, and blocks are returned aligned to max_align_t.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+
+struct AllocatorBackend
+{
+	const char* name;
+	void* (*allocate)(size_t size);
+	void (*deallocate)(void* ptr, size_t size);
+	void* (*reallocate)(void* ptr, size_t old_size, size_t size);
+};
+
+constexpr size_t backend_alignment = alignof(std::max_align_t);
+
+constexpr size_t backend_round_up(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Spins rather than sleeping, since every critical section below is a handful of pointer updates
+struct BackendLock
+{
+	std::atomic_flag flag = ATOMIC_FLAG_INIT;
+
+	void lock()
+	{
+		while (flag.test_and_set(std::memory_order_acquire))
+			;
+	}
+
+	void unlock()
+	{
+		flag.clear(std::memory_order_release);
+	}
+};
+
+// Intrusive free list node, stored in the free block itself
+struct BackendFreeBlock
+{
+	BackendFreeBlock* next;
+};
+
+// Fallback for backends that can't resize in place
+template <void* (*Allocate)(size_t), void (*Deallocate)(void*, size_t)>
+void* backend_reallocate_by_copy(void* ptr, size_t old_size, size_t size)
+{
+	void* block = Allocate(size);
+	if (block == nullptr)
+		return nullptr;
+
+	memcpy(block, ptr, std::min(old_size, size));
+	Deallocate(ptr, old_size);
+	return block;
+}
+
+// libc
+
+void* libc_allocate(size_t size)
+{
+	return malloc(size);
+}
+
+void libc_deallocate(void* ptr, size_t)
+{
+	free(ptr);
+}
+
+void* libc_reallocate(void* ptr, size_t, size_t size)
+{
+	return realloc(ptr, size);
+}
+
+// Size classes shared by the slab pool and the thread cache: every multiple of 16 bytes up to 256, then four
+// classes per power of two up to 32 KB. Anything larger goes straight to libc.
+constexpr size_t size_class_small_limit = 256;
+constexpr size_t size_class_limit = 32 * 1024;
+constexpr int size_class_count = int(size_class_small_limit / backend_alignment) + 4 * 7;
+
+// Memory is carved into blocks of a size class from spans of at least this size, which are never returned
+constexpr size_t size_class_span_bytes = 64 * 1024;
+
+int size_class_index(size_t size)
+{
+	if (size <= size_class_small_limit)
+		return int(backend_round_up(size, backend_alignment) / backend_alignment) - 1;
+
+	// Each power of two above 256 is split into quarters
+	size_t power = size_t(1) << (63 - __builtin_clzll(size - 1));
+	size_t quarter = power / 4;
+	int step = int((size - 1 - power) / quarter);
+	int doublings = 63 - __builtin_clzll(power / size_class_small_limit);
+	return int(size_class_small_limit / backend_alignment) + doublings * 4 + step;
+}
+
+size_t size_class_bytes(int index)
+{
+	int small_classes = int(size_class_small_limit / backend_alignment);
+	if (index < small_classes)
+		return size_t(index + 1) * backend_alignment;
+
+	int doublings = (index - small_classes) / 4;
+	int step = (index - small_classes) % 4;
+	size_t power = size_class_small_limit << doublings;
+	return power + (power / 4) * size_t(step + 1);
+}
+
+// A central free list per size class, refilled from spans, behind a lock. Both the slab pool and the thread cache
+// are built on one of these.
+struct SizeClassPool
+{
+	BackendLock lock;
+	BackendFreeBlock* free_list = nullptr;
+	char* span_next = nullptr;
+	char* span_end = nullptr;
+
+	// Pops up to count blocks into a list, returning how many it got
+	int take(size_t block_bytes, BackendFreeBlock*& list, int count)
+	{
+		lock.lock();
+
+		int taken = 0;
+		for (; taken < count; taken++)
+		{
+			BackendFreeBlock* block = free_list;
+			if (block != nullptr)
+				free_list = block->next;
+			else
+			{
+				if (span_next == span_end)
+				{
+					size_t span_bytes = std::max(size_class_span_bytes, block_bytes * 8);
+					span_next = (char*)malloc(span_bytes);
+					if (span_next == nullptr)
+						break;
+					span_end = span_next + span_bytes / block_bytes * block_bytes;
+				}
+
+				block = (BackendFreeBlock*)span_next;
+				span_next += block_bytes;
+			}
+
+			block->next = list;
+			list = block;
+		}
+
+		lock.unlock();
+		return taken;
+	}
+
+	// Pushes a list of blocks, first to last, onto the free list
+	void give(BackendFreeBlock* first, BackendFreeBlock* last)
+	{
+		lock.lock();
+		last->next = free_list;
+		free_list = first;
+		lock.unlock();
+	}
+};
+
+// Slab pool: one locked free list per size class, shared by every thread
+
+SizeClassPool slab_pools[size_class_count];
+
+void* slab_allocate(size_t size)
+{
+	if (size > size_class_limit)
+		return malloc(size);
+
+	int index = size_class_index(size);
+	BackendFreeBlock* block = nullptr;
+	slab_pools[index].take(size_class_bytes(index), block, 1);
+	return block;
+}
+
+void slab_deallocate(void* ptr, size_t size)
+{
+	if (size > size_class_limit)
+		return free(ptr);
+
+	BackendFreeBlock* block = (BackendFreeBlock*)ptr;
+	slab_pools[size_class_index(size)].give(block, block);
+}
+
+// Blocks that stay within their size class keep their place
+void* slab_reallocate(void* ptr, size_t old_size, size_t size)
+{
+	if (old_size > size_class_limit && size > size_class_limit)
+		return realloc(ptr, size);
+	if (old_size <= size_class_limit && size <= size_class_limit && size_class_index(old_size) == size_class_index(size))
+		return ptr;
+
+	return backend_reallocate_by_copy<slab_allocate, slab_deallocate>(ptr, old_size, size);
+}
+
+// Thread cache: each thread keeps its own free lists and only takes the lock to move blocks to or from the central
+// pools in batches, the way tcmalloc does
+
+SizeClassPool thread_cache_central_pools[size_class_count];
+
+// Blocks moved between a thread and the central pool at once, and the most a thread keeps before handing some back
+constexpr int thread_cache_batch = 32;
+constexpr int thread_cache_max_blocks = thread_cache_batch * 2;
+
+struct ThreadCache
+{
+	BackendFreeBlock* free_lists[size_class_count] = {};
+	int counts[size_class_count] = {};
+
+	// Blocks a thread frees are only usable by other threads once they're back in the central pool
+	~ThreadCache()
+	{
+		for (int i = 0; i < size_class_count; i++)
+			release(i, counts[i]);
+	}
+
+	void release(int index, int count)
+	{
+		if (count == 0)
+			return;
+
+		BackendFreeBlock* first = free_lists[index];
+		BackendFreeBlock* last = first;
+		for (int i = 1; i < count; i++)
+			last = last->next;
+
+		free_lists[index] = last->next;
+		counts[index] -= count;
+		thread_cache_central_pools[index].give(first, last);
+	}
+};
+
+thread_local ThreadCache thread_cache;
+
+void* thread_cache_allocate(size_t size)
+{
+	if (size > size_class_limit)
+		return malloc(size);
+
+	int index = size_class_index(size);
+	if (thread_cache.counts[index] == 0)
+		thread_cache.counts[index] = thread_cache_central_pools[index].take(size_class_bytes(index), thread_cache.free_lists[index], thread_cache_batch);
+
+	BackendFreeBlock* block = thread_cache.free_lists[index];
+	if (block == nullptr)
+		return nullptr;
+
+	thread_cache.free_lists[index] = block->next;
+	thread_cache.counts[index] -= 1;
+	return block;
+}
+
+void thread_cache_deallocate(void* ptr, size_t size)
+{
+	if (size > size_class_limit)
+		return free(ptr);
+
+	int index = size_class_index(size);
+	BackendFreeBlock* block = (BackendFreeBlock*)ptr;
+	block->next = thread_cache.free_lists[index];
+	thread_cache.free_lists[index] = block;
+	thread_cache.counts[index] += 1;
+
+	if (thread_cache.counts[index] > thread_cache_max_blocks)
+		thread_cache.release(index, thread_cache_batch);
+}
+
+void* thread_cache_reallocate(void* ptr, size_t old_size, size_t size)
+{
+	if (old_size > size_class_limit && size > size_class_limit)
+		return realloc(ptr, size);
+	if (old_size <= size_class_limit && size <= size_class_limit && size_class_index(old_size) == size_class_index(size))
+		return ptr;
+
+	return backend_reallocate_by_copy<thread_cache_allocate, thread_cache_deallocate>(ptr, old_size, size);
+}
+
+// Bump arena: allocations are carved off the end of the current chunk and frees only drop a live count. When
+// nothing is live the arena rewinds, so tests that clean up after themselves don't grow it without bound.
+
+// Chunks are at least this size, and the current chunk is kept over a rewind
+constexpr size_t arena_chunk_bytes = 1024 * 1024;
+
+struct ArenaChunk
+{
+	ArenaChunk* previous;
+	size_t size;
+};
+
+constexpr size_t arena_chunk_header_size = backend_round_up(sizeof(ArenaChunk), backend_alignment);
+
+struct Arena
+{
+	BackendLock lock;
+	ArenaChunk* chunk = nullptr;
+	char* next = nullptr;
+	char* end = nullptr;
+	char* last_block = nullptr;
+	size_t live = 0;
+};
+
+Arena arena;
+
+// Call with the arena locked
+void* arena_allocate_locked(size_t size)
+{
+	size = backend_round_up(size, backend_alignment);
+
+	if (size_t(arena.end - arena.next) < size)
+	{
+		size_t chunk_bytes = std::max(arena_chunk_bytes, size + arena_chunk_header_size);
+		ArenaChunk* chunk = (ArenaChunk*)malloc(chunk_bytes);
+		if (chunk == nullptr)
+			return nullptr;
+
+		chunk->previous = arena.chunk;
+		chunk->size = chunk_bytes;
+		arena.chunk = chunk;
+		arena.next = (char*)chunk + arena_chunk_header_size;
+		arena.end = (char*)chunk + chunk_bytes;
+	}
+
+	arena.last_block = arena.next;
+	arena.next += size;
+	arena.live += 1;
+	return arena.last_block;
+}
+
+void* arena_allocate(size_t size)
+{
+	arena.lock.lock();
+	void* block = arena_allocate_locked(size);
+	arena.lock.unlock();
+	return block;
+}
+
+void arena_deallocate(void*, size_t)
+{
+	arena.lock.lock();
+
+	arena.live -= 1;
+	if (arena.live == 0)
+	{
+		// Only a chunk of the default size is worth keeping, an oversized one was made for a single large block
+		while (arena.chunk != nullptr && (arena.chunk->previous != nullptr || arena.chunk->size > arena_chunk_bytes))
+		{
+			ArenaChunk* previous = arena.chunk->previous;
+			free(arena.chunk);
+			arena.chunk = previous;
+		}
+
+		arena.next = arena.chunk != nullptr ? (char*)arena.chunk + arena_chunk_header_size : nullptr;
+		arena.end = arena.chunk != nullptr ? (char*)arena.chunk + arena.chunk->size : nullptr;
+		arena.last_block = nullptr;
+	}
+
+	arena.lock.unlock();
+}
+
+// The most recent block can grow or shrink in place, which is what makes an arena cheap for a single growing buffer
+void* arena_reallocate(void* ptr, size_t old_size, size_t size)
+{
+	arena.lock.lock();
+
+	if (ptr == arena.last_block && size_t(arena.end - (char*)ptr) >= backend_round_up(size, backend_alignment))
+	{
+		arena.next = (char*)ptr + backend_round_up(size, backend_alignment);
+		arena.lock.unlock();
+		return ptr;
+	}
+
+	void* block = arena_allocate_locked(size);
+	arena.lock.unlock();
+
+	if (block != nullptr)
+	{
+		memcpy(block, ptr, std::min(old_size, size));
+		arena_deallocate(ptr, old_size);
+	}
+	return block;
+}
+
+// Every backend, in the order they are run. Blocks record the index of the backend they came from, so switching
+// with blocks still live is safe.
+const AllocatorBackend allocator_backends[] = {
+	{ "libc", libc_allocate, libc_deallocate, libc_reallocate },
+	{ "thread_cache", thread_cache_allocate, thread_cache_deallocate, thread_cache_reallocate },
+	{ "arena", arena_allocate, arena_deallocate, arena_reallocate },
+	{ "slab", slab_allocate, slab_deallocate, slab_reallocate },
+};
+
+constexpr int allocator_backend_count = int(sizeof(allocator_backends) / sizeof(allocator_backends[0]));
+
+std::atomic<int> counted_malloc_backend = 0;
+
+// Returns false when there's no backend with that name
+bool counted_malloc_set_backend(const char* name)
+{
+	for (int i = 0; i < allocator_backend_count; i++)
+	{
+		if (strcmp(allocator_backends[i].name, name) == 0)
+		{
+			counted_malloc_backend = i;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+// Opt-in allocation call-site profiler for counted_malloc, enabled with TEST_HARNESS_ALLOCATION_PROFILER.
+// Each counted allocation records a hash of its backtrace in the block header, so sites can be counted on the
+// way in and out. Frames are kept as raw addresses and only symbolised with backtrace_symbols when reported.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <execinfo.h>
+
+// Frames kept per site, after dropping the profiler's own
+constexpr int profiler_max_frames = 8;
+
+// profiler_record_allocation and counted_malloc/counted_realloc, all kept out of line
+constexpr int profiler_skipped_frames = 2;
+
+// Fixed size, so recording never allocates. Sites past this are counted as overflow.
+constexpr uint32_t profiler_max_sites = 4096;
+
+// Sites printed for each of the by count and by bytes listings
+constexpr int profiler_report_sites = 3;
+
+constexpr uint32_t profiler_no_site = UINT32_MAX;
+
+struct AllocationSite
+{
+	uint64_t hash;
+	void* frames[profiler_max_frames];
+	int frame_count;
+
+	std::atomic<size_t> allocations;
+	std::atomic<size_t> bytes;
+	std::atomic<int64_t> live_allocations;
+	std::atomic<int64_t> live_bytes;
+};
+
+AllocationSite profiler_sites[profiler_max_sites];
+std::atomic<size_t> profiler_overflow = 0;
+std::atomic_flag profiler_lock = ATOMIC_FLAG_INIT;
+
+// Bumped on every reset. Blocks remember the low bits of the generation they were allocated in, so frees of blocks
+// from before a reset don't go against the new counts.
+std::atomic<uint32_t> profiler_generation = 1;
+
+uint32_t profiler_find_site(void* const* frames, int frame_count)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+	for (int i = 0; i < frame_count; i++)
+		hash = (hash ^ uint64_t(frames[i])) * 0x100000001b3;
+	if (hash == 0)
+		hash = 1;
+
+	while (profiler_lock.test_and_set(std::memory_order_acquire))
+		;
+
+	uint32_t index = uint32_t(hash) & (profiler_max_sites - 1);
+	for (uint32_t probe = 0; probe < profiler_max_sites; probe++)
+	{
+		AllocationSite& site = profiler_sites[index];
+
+		if (site.hash == hash)
+			break;
+
+		if (site.hash == 0)
+		{
+			site.hash = hash;
+			site.frame_count = frame_count;
+			std::copy(frames, frames + frame_count, site.frames);
+			break;
+		}
+
+		index = (index + 1) & (profiler_max_sites - 1);
+	}
+
+	bool found = profiler_sites[index].hash == hash;
+	profiler_lock.clear(std::memory_order_release);
+
+	return found ? index : profiler_no_site;
+}
+
+// Returns the site to store in the block header
+[[gnu::noinline]] uint32_t profiler_record_allocation(size_t sz)
+{
+	void* frames[profiler_max_frames + profiler_skipped_frames];
+	int frame_count = backtrace(frames, profiler_max_frames + profiler_skipped_frames) - profiler_skipped_frames;
+	if (frame_count < 0)
+		frame_count = 0;
+
+	uint32_t index = profiler_find_site(frames + profiler_skipped_frames, frame_count);
+	if (index == profiler_no_site)
+	{
+		profiler_overflow += 1;
+		return profiler_no_site;
+	}
+
+	AllocationSite& site = profiler_sites[index];
+	site.allocations += 1;
+	site.bytes += sz;
+	site.live_allocations += 1;
+	site.live_bytes += int64_t(sz);
+
+	return index;
+}
+
+void profiler_record_free(uint32_t index, uint16_t generation, size_t sz)
+{
+	if (index == profiler_no_site || generation != uint16_t(profiler_generation))
+		return;
+
+	profiler_sites[index].live_allocations -= 1;
+	profiler_sites[index].live_bytes -= int64_t(sz);
+}
+
+void profiler_reset()
+{
+	profiler_generation += 1;
+	profiler_overflow = 0;
+
+	for (AllocationSite& site : profiler_sites)
+	{
+		site.hash = 0;
+		site.allocations = 0;
+		site.bytes = 0;
+		site.live_allocations = 0;
+		site.live_bytes = 0;
+	}
+}
+
+void profiler_output_site(const AllocationSite& site)
+{
+	printf("      %zu allocations, %zu bytes, %lld live allocations, %lld live bytes\n",
+		site.allocations.load(), site.bytes.load(), (long long)site.live_allocations.load(), (long long)site.live_bytes.load());
+
+	char** symbols = backtrace_symbols(site.frames, site.frame_count);
+	if (symbols == nullptr)
+		return;
+
+	for (int i = 0; i < site.frame_count; i++)
+		printf("        %s\n", symbols[i]);
+
+	free(symbols);
+}
+
+template <typename Compare>
+void profiler_output_top_sites(const char* heading, Compare&& compare)
+{
+	const AllocationSite* sorted[profiler_max_sites];
+	int count = 0;
+
+	for (const AllocationSite& site : profiler_sites)
+		if (site.hash != 0 && site.allocations != 0)
+			sorted[count++] = &site;
+
+	if (count == 0)
+		return;
+
+	int shown = std::min(count, profiler_report_sites);
+	std::partial_sort(sorted, sorted + shown, sorted + count, [&](const AllocationSite* a, const AllocationSite* b) { return compare(*a, *b); });
+
+	printf("    %s:\n", heading);
+	for (int i = 0; i < shown; i++)
+		profiler_output_site(*sorted[i]);
+}
+
+// Top sites by count and by bytes since the last reset, and every site with allocations still live
+void profiler_output_report()
+{
+	profiler_output_top_sites("top allocation sites by count", [](const AllocationSite& a, const AllocationSite& b) { return a.allocations > b.allocations; });
+	profiler_output_top_sites("top allocation sites by bytes", [](const AllocationSite& a, const AllocationSite& b) { return a.bytes > b.bytes; });
+
+	bool any_live = false;
+	for (const AllocationSite& site : profiler_sites)
+	{
+		if (site.hash == 0 || site.live_allocations <= 0)
+			continue;
+
+		if (!any_live)
+			printf("    live allocation sites:\n");
+		any_live = true;
+
+		profiler_output_site(site);
+	}
+
+	if (profiler_overflow != 0)
+		printf("    %zu allocations not recorded, site table full\n", profiler_overflow.load());
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// Run time settings shared by every suite, set from the command line by main
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+enum class OutputFormat
+{
+	Text,
+
+	// One JSON object per line for every result, warning and benchmark, with everything else sent to stderr
+	Json
+};
+
+struct HarnessOptions
+{
+	// Comma separated globs, matched against suite names and test or benchmark names
+	const char* suites = "*";
+	const char* tests = "*";
+
+	int repeat = 1;
+
+	// Seeds the randomised tests
+	uint32_t seed = 42;
+
+	// Core to pin the process to, or -1 to leave it to the scheduler
+	int cpu = -1;
+
+	// Untimed runs before benchmark_ns and benchmark_cycles start taking samples
+	int warmup = 1;
+
+	OutputFormat format = OutputFormat::Text;
+};
+
+HarnessOptions harness_options;
+
+// Where JSON lines go, which isn't stdout once that's been pointed at stderr
+FILE* json_output = stdout;
+
+// Suite and allocator being run, set by main. They're kept with benchmark results, so have to outlive them.
+const char* current_suite = "";
+const char* current_allocator = "";
+
+// Matches * against any run of characters and ? against any one character
+bool glob_match(const char* pattern, const char* pattern_end, const char* text)
+{
+	if (pattern == pattern_end)
+		return *text == '\0';
+
+	if (*pattern == '*')
+		return glob_match(pattern + 1, pattern_end, text) || (*text != '\0' && glob_match(pattern, pattern_end, text + 1));
+
+	if (*text == '\0' || (*pattern != '?' && *pattern != *text))
+		return false;
+
+	return glob_match(pattern + 1, pattern_end, text + 1);
+}
+
+// Whether name matches any of a comma separated list of globs
+bool glob_list_match(const char* globs, const char* name)
+{
+	for (const char* start = globs;;)
+	{
+		const char* end = strchr(start, ',');
+		if (end == nullptr)
+			end = start + strlen(start);
+
+		if (glob_match(start, end, name))
+			return true;
+
+		if (*end == '\0')
+			return false;
+		start = end + 1;
+	}
+}
+
+bool suite_selected(const char* suite)
+{
+	return glob_list_match(harness_options.suites, suite);
+}
+
+bool test_selected(const char* name)
+{
+	return glob_list_match(harness_options.tests, name);
+}
+
+void output_json_string(const char* text)
+{
+	fputc('"', json_output);
+	for (; *text != '\0'; text++)
+	{
+		if (*text == '"' || *text == '\\')
+			fputc('\\', json_output);
+		fputc(*text, json_output);
+	}
+	fputc('"', json_output);
+}
+
+// Starts a JSON line with the fields every line has, leaving the object open for the caller to finish
+void output_json_line_start(const char* type, const char* name)
+{
+	fprintf(json_output, "{\"type\": ");
+	output_json_string(type);
+	fprintf(json_output, ", \"suite\": ");
+	output_json_string(current_suite);
+	fprintf(json_output, ", \"allocator\": ");
+	output_json_string(current_allocator);
+	fprintf(json_output, ", \"name\": ");
+	output_json_string(name);
+}
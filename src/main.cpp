@@ -1,29 +1,321 @@
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+
 #include "tests_vector.h"
 #include "tests_unique_ptr.h"
 #include "tests_shared_ptr.h"
+#include "tests_atomic_shared_ptr.h"
+#include "tests_intrusive_ptr.h"
+#include "tests_deque.h"
+#include "tests_hash_map.h"
+#include "tests_string.h"
+#include "tests_function.h"
+#include "tests_optional.h"
+#include "tests_variant.h"
+#include "tests_spsc_queue.h"
+#include "tests_mpmc_queue.h"
+#include "tests_concurrent_map.h"
+#include "tests_soak.h"
 
-template <typename T>
-struct my_vector
+#include "candidates.h"
+
+#ifdef TEST_HARNESS_CONSTEXPR_GATE
+// Candidates usable in constant expressions have their constexpr tests checked as they're compiled
+static_assert(tests_vector::constexpr_gate<my_vector>());
+static_assert(tests_unique_ptr::constexpr_gate<my_unique_ptr>());
+#endif
+
+// Seconds the soak benchmark runs for, which is skipped unless asked for
+double soak_seconds = 0;
+
+#ifdef TEST_HARNESS_RESULT_CACHE
+// SHA-256 of the suite's preprocessed test header and the candidates, generated at build time
+const char* candidate_source_hash(const char* suite);
+#endif
+
+// Everything that changes what a suite reports, or empty when the suite can't be cached
+std::string result_cache_key(const char* suite)
 {
+#ifdef TEST_HARNESS_RESULT_CACHE
+	const char* hash = candidate_source_hash(suite);
+	if (hash == nullptr)
+		return "";
 
-};
+	char options[512];
+	snprintf(options, sizeof(options), "|%s|%s|seed %u|warmup %d|tests %s|soak %g", suite, current_allocator,
+		harness_options.seed, harness_options.warmup, harness_options.tests, soak_seconds);
+	return std::string(hash) + "|" TEST_HARNESS_VERSION + options;
+#else
+	return suite;
+#endif
+}
 
-template <typename T>
-struct my_unique_ptr
+// Outputs a suite's stored records as if it had just run, without the free form text in between
+void replay_suite(const char* name, const std::vector<std::string>& records)
 {
+	printf("\n%s (cached)\n-------------------------------\n", name);
+
+	for (const std::string& record : records)
+	{
+		size_t name_start = record.find('\t');
+		size_t payload_start = name_start == std::string::npos ? name_start : record.find('\t', name_start + 1);
+		if (payload_start == std::string::npos)
+			continue;
+
+		std::string type = record.substr(0, name_start);
+		std::string test = record.substr(name_start + 1, payload_start - name_start - 1);
+		const char* payload = record.c_str() + payload_start + 1;
+
+		if (type == "result")
+			output_result(test.c_str(), TestResult(atoi(payload)), strchr(payload, '\t') == nullptr ? nullptr : strchr(payload, '\t') + 1);
+		else if (type == "warning")
+			output_warning(test.c_str(), payload);
+		else if (type == "benchmark" && strchr(payload, '\t') != nullptr)
+			output_benchmark(test.c_str(), atof(payload), strchr(payload, '\t') + 1);
+	}
+
+	printf("\n");
+}
+
+template <typename F>
+void run_suite(const char* name, F&& suite)
+{
+	if (!suite_selected(name))
+		return;
+
+	current_suite = name;
+
+	std::string key = result_cache_key(name);
+	if (key.empty())
+	{
+		suite();
+		return;
+	}
+
+	if (const std::vector<std::string>* records = result_cache_find(key))
+	{
+		replay_suite(name, *records);
+		return;
+	}
+
+	result_cache_begin(key);
+	suite();
+	result_cache_commit();
+}
+
+void run_suites()
+{
+	run_suite("vector", tests_vector::run<my_vector>);
+	run_suite("unique_ptr", tests_unique_ptr::run<my_unique_ptr>);
+	run_suite("shared_ptr", tests_shared_ptr::run<my_shared_ptr, my_enable_shared_from_this>);
+	run_suite("atomic_shared_ptr", tests_atomic_shared_ptr::run<my_atomic_shared_ptr, my_shared_ptr>);
+	run_suite("intrusive_ptr", tests_intrusive_ptr::run<my_intrusive_ptr, my_shared_ptr>);
+	run_suite("deque", tests_deque::run<my_deque>);
+	run_suite("hash_map", tests_hash_map::run<my_hash_map>);
+	run_suite("string", tests_string::run<my_string>);
+	run_suite("function", tests_function::run<my_function>);
+	run_suite("optional", tests_optional::run<my_optional>);
+	run_suite("variant", tests_variant::run<my_variant>);
+	run_suite("spsc_queue", tests_spsc_queue::run<my_spsc_queue>);
+	run_suite("mpmc_queue", tests_mpmc_queue::run<my_mpmc_queue>);
+	run_suite("concurrent_map", tests_concurrent_map::run<my_concurrent_map>);
+
+	if (soak_seconds > 0)
+		run_suite("soak", [] { tests_soak::run<my_vector, my_shared_ptr>(soak_seconds); });
+}
 
-};
+void output_usage()
+{
+	fprintf(stderr,
+		"Usage: TestHarness [options]\n"
+		"  --suite <globs>      suites to run, comma separated, * and ? match as in the shell (default *)\n"
+		"  --test <globs>       tests and benchmarks to run within them (default *)\n"
+		"  --repeat <n>         run everything selected n times (default 1)\n"
+		"  --seed <n>           seed for the randomised tests (default 42)\n"
+		"  --cpu <n>            pin the process to core n\n"
+		"  --warmup <n>         untimed runs before each benchmark takes samples (default 1)\n"
+		"  --format text|json   json writes one object per result to stdout, and everything else to stderr\n"
+		"  --allocator <name>   libc, thread_cache, arena, slab, or all to compare them (default libc)\n"
+		"  --soak <seconds>     also run the fragmentation soak for this long\n"
+		"  --cache <path>       replay suites from this result cache when the candidates and harness haven't changed,\n"
+		"                       and add the ones that had to run\n"
+		"  --invalidate-cache   run everything, replacing what's in the cache\n");
+}
 
+// The whole string has to be a number in range, so a typo is an error rather than 0
 template <typename T>
-struct my_shared_ptr
+bool parse_integer(const char* value, long long min, long long max, T& result)
+{
+	char* end = nullptr;
+	errno = 0;
+	long long parsed = strtoll(value, &end, 10);
+	if (end == value || *end != '\0' || errno == ERANGE || parsed < min || parsed > max)
+		return false;
+
+	result = T(parsed);
+	return true;
+}
+
+bool parse_seconds(const char* value, double& result)
 {
+	char* end = nullptr;
+	double parsed = strtod(value, &end);
+	if (end == value || *end != '\0' || !(parsed > 0))
+		return false;
 
-};
+	result = parsed;
+	return true;
+}
 
-int main()
+bool parse_arguments(int argc, char** argv, const char*& allocator, const char*& cache_path, bool& invalidate_cache)
 {
-	tests_vector::run<my_vector>();
-	tests_unique_ptr::run<my_unique_ptr>();
-	tests_shared_ptr::run<my_shared_ptr>();
+	for (int i = 1; i < argc; i++)
+	{
+		const char* option = argv[i];
+		if (strcmp(option, "--invalidate-cache") == 0)
+		{
+			invalidate_cache = true;
+			continue;
+		}
+
+		if (strcmp(option, "--help") == 0 || i + 1 == argc)
+			return false;
+
+		const char* value = argv[++i];
+
+		if (strcmp(option, "--suite") == 0)
+			harness_options.suites = value;
+		else if (strcmp(option, "--test") == 0)
+			harness_options.tests = value;
+		else if (strcmp(option, "--repeat") == 0)
+		{
+			if (!parse_integer(value, 1, INT_MAX, harness_options.repeat))
+				return false;
+		}
+		else if (strcmp(option, "--seed") == 0)
+		{
+			if (!parse_integer(value, 0, UINT32_MAX, harness_options.seed))
+				return false;
+		}
+		else if (strcmp(option, "--cpu") == 0)
+		{
+			if (!parse_integer(value, 0, INT_MAX, harness_options.cpu))
+				return false;
+		}
+		else if (strcmp(option, "--warmup") == 0)
+		{
+			if (!parse_integer(value, 0, INT_MAX, harness_options.warmup))
+				return false;
+		}
+		else if (strcmp(option, "--format") == 0 && strcmp(value, "text") == 0)
+			harness_options.format = OutputFormat::Text;
+		else if (strcmp(option, "--format") == 0 && strcmp(value, "json") == 0)
+			harness_options.format = OutputFormat::Json;
+		else if (strcmp(option, "--allocator") == 0)
+			allocator = value;
+		else if (strcmp(option, "--soak") == 0)
+		{
+			if (!parse_seconds(value, soak_seconds))
+				return false;
+		}
+		else if (strcmp(option, "--cache") == 0)
+			cache_path = value;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+// Keeps benchmarks on one core, so they aren't migrated mid sample and stay warm in its caches
+bool pin_to_cpu(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	const char* allocator = "libc";
+	const char* cache_path = nullptr;
+	bool invalidate_cache = false;
+	if (!parse_arguments(argc, argv, allocator, cache_path, invalidate_cache))
+	{
+		output_usage();
+		return 1;
+	}
+
+	if (cache_path != nullptr)
+	{
+#ifdef TEST_HARNESS_RESULT_CACHE
+		if (!result_cache_open(cache_path, invalidate_cache))
+		{
+			fprintf(stderr, "can't read result cache %s\n", cache_path);
+			return 1;
+		}
+#else
+		fprintf(stderr, "built without TEST_HARNESS_RESULT_CACHE, so there's no candidate hash to key a cache with\n");
+		return 1;
+#endif
+	}
+
+	bool all_allocators = strcmp(allocator, "all") == 0;
+	if (!all_allocators && !counted_malloc_set_backend(allocator))
+	{
+		fprintf(stderr, "unknown allocator: %s\n", allocator);
+		return 1;
+	}
+
+	if (harness_options.cpu >= 0 && !pin_to_cpu(harness_options.cpu))
+	{
+		fprintf(stderr, "can't pin to cpu %d\n", harness_options.cpu);
+		return 1;
+	}
+
+#ifdef __linux__
+	if (harness_options.format == OutputFormat::Json)
+	{
+		// Everything the suites print as text goes to stderr, so stdout only carries JSON lines
+		fflush(stdout);
+		json_output = fdopen(dup(STDOUT_FILENO), "w");
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	}
+#endif
+
+	for (int i = 0; i < harness_options.repeat; i++)
+	{
+		if (!all_allocators)
+		{
+			current_allocator = allocator;
+			run_suites();
+			continue;
+		}
+
+		for (const AllocatorBackend& backend : allocator_backends)
+		{
+			counted_malloc_set_backend(backend.name);
+			current_allocator = backend.name;
+
+			printf("\n=== Allocator: %s ===\n", backend.name);
+			run_suites();
+		}
+	}
+
+	if (all_allocators)
+		output_allocator_report();
+
+	fflush(json_output);
 	return 0;
-}
\ No newline at end of file
+}
@@ -1,9 +1,9 @@
 #include "memory_correctness_item.h"
 
-uint64_t MemoryCorrectnessItem::count_constructed = 0;
-uint64_t MemoryCorrectnessItem::count_constructed_copy = 0;
-uint64_t MemoryCorrectnessItem::count_constructed_move = 0;
-uint64_t MemoryCorrectnessItem::count_assigned_copy = 0;
-uint64_t MemoryCorrectnessItem::count_assigned_move = 0;
-uint64_t MemoryCorrectnessItem::count_destroyed = 0;
-uint64_t MemoryCorrectnessItem::errors_occurred = 0;
\ No newline at end of file
+std::atomic<uint64_t> MemoryCorrectnessItem::count_constructed = 0;
+std::atomic<uint64_t> MemoryCorrectnessItem::count_constructed_copy = 0;
+std::atomic<uint64_t> MemoryCorrectnessItem::count_constructed_move = 0;
+std::atomic<uint64_t> MemoryCorrectnessItem::count_assigned_copy = 0;
+std::atomic<uint64_t> MemoryCorrectnessItem::count_assigned_move = 0;
+std::atomic<uint64_t> MemoryCorrectnessItem::count_destroyed = 0;
+std::atomic<uint64_t> MemoryCorrectnessItem::errors_occurred = 0;
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <atomic>
 
 class MemoryCorrectnessItem
 {
@@ -9,81 +10,81 @@ public:
     {
         if (memory_initialization_token == 0x2c1dd27f0d59cf3e && status != MemoryStatus::Deleted)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         status = MemoryStatus::Constructed;
         memory_initialization_token = 0x2c1dd27f0d59cf3e;
-        count_constructed += 1;
+        count_constructed.fetch_add(1, std::memory_order_relaxed);
     }
 
     MemoryCorrectnessItem(const MemoryCorrectnessItem& other) : id(other.id)
     {
         if (other.memory_initialization_token != 0x2c1dd27f0d59cf3e)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (other.status == MemoryStatus::Deleted)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (other.status == MemoryStatus::MovedFrom)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (memory_initialization_token == 0x2c1dd27f0d59cf3e && status != MemoryStatus::Deleted)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         status = MemoryStatus::Constructed;
         memory_initialization_token = 0x2c1dd27f0d59cf3e;
-        count_constructed_copy += 1;
+        count_constructed_copy.fetch_add(1, std::memory_order_relaxed);
     }
 
     MemoryCorrectnessItem(MemoryCorrectnessItem&& other) : id(other.id)
     {
         if (other.memory_initialization_token != 0x2c1dd27f0d59cf3e)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (other.status == MemoryStatus::Deleted)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (other.status == MemoryStatus::MovedFrom)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (memory_initialization_token == 0x2c1dd27f0d59cf3e && status != MemoryStatus::Deleted)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         other.id = -1;
         other.status = MemoryStatus::MovedFrom;
         status = MemoryStatus::Constructed;
         memory_initialization_token = 0x2c1dd27f0d59cf3e;
-        count_constructed_move += 1;
+        count_constructed_move.fetch_add(1, std::memory_order_relaxed);
     }
 
     MemoryCorrectnessItem& operator=(const MemoryCorrectnessItem& other)
     {
         if (other.memory_initialization_token != 0x2c1dd27f0d59cf3e)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (other.status == MemoryStatus::Deleted)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (other.status == MemoryStatus::MovedFrom)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (memory_initialization_token != 0x2c1dd27f0d59cf3e)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         id = other.id;
-        count_assigned_copy += 1;
+        count_assigned_copy.fetch_add(1, std::memory_order_relaxed);
         return *this;
     }
 
@@ -91,24 +92,24 @@ public:
     {
         if (other.memory_initialization_token != 0x2c1dd27f0d59cf3e)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (other.status == MemoryStatus::Deleted)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (other.status == MemoryStatus::MovedFrom)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (memory_initialization_token != 0x2c1dd27f0d59cf3e)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         id = other.id;
         other.id = -1;
         other.status = MemoryStatus::MovedFrom;
-        count_assigned_move += 1;
+        count_assigned_move.fetch_add(1, std::memory_order_relaxed);
         return *this;
     }
 
@@ -116,14 +117,19 @@ public:
     {
         if (memory_initialization_token != 0x2c1dd27f0d59cf3e)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         if (status == MemoryStatus::Deleted)
         {
-            errors_occurred += 1;
+            errors_occurred.fetch_add(1, std::memory_order_relaxed);
         }
         status = MemoryStatus::Deleted;
-        count_destroyed += 1;
+
+        // Cleared so memory reused for a new item doesn't look like it already holds one. Otherwise a token left
+        // behind at an offset that lines up differently with the new item reads as a constructed item being
+        // constructed over.
+        memory_initialization_token = 0;
+        count_destroyed.fetch_add(1, std::memory_order_relaxed);
     }
 
     int id;
@@ -169,12 +175,14 @@ public:
         errors_occurred = 0;
     }
 
-    static uint64_t count_constructed;
-    static uint64_t count_constructed_copy;
-    static uint64_t count_constructed_move;
-    static uint64_t count_assigned_copy;
-    static uint64_t count_assigned_move;
-    static uint64_t count_destroyed;
+    // Atomic so that concurrent containers can be checked from many threads at once, but incremented relaxed, as
+    // they're only read once the threads are joined and single threaded benchmarks shouldn't pay for ordering
+    static std::atomic<uint64_t> count_constructed;
+    static std::atomic<uint64_t> count_constructed_copy;
+    static std::atomic<uint64_t> count_constructed_move;
+    static std::atomic<uint64_t> count_assigned_copy;
+    static std::atomic<uint64_t> count_assigned_move;
+    static std::atomic<uint64_t> count_destroyed;
 
-    static uint64_t errors_occurred;
+    static std::atomic<uint64_t> errors_occurred;
 };
@@ -0,0 +1,543 @@
+#pragma once
+
+// Tests and benchmarks shared by the SPSC and MPMC queue suites, which only differ in how many threads push and pop.
+// Candidates are bounded, constructed with a capacity, and have bool try_push(T&&) and bool try_pop(T&).
+
+#include <cstdio>
+#include <cstdint>
+#include <new>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+#include "concurrency_common.h"
+
+// Capacity asked for in the basic test, which a candidate may round up to at most double
+constexpr size_t queue_test_capacity = 16;
+
+// Items each producer pushes in the exactly once test
+constexpr int queue_items_per_producer = 100000;
+
+// Linearizability is checked on many short histories, which the checker can search, with a capacity small enough
+// that pushes find the queue full as well as pops finding it empty
+constexpr int queue_histories = 500;
+constexpr int queue_history_operations_per_thread = 8;
+constexpr size_t queue_history_capacity = 4;
+
+constexpr size_t queue_benchmark_capacity = 1024;
+constexpr auto queue_benchmark_duration = std::chrono::milliseconds(100);
+constexpr int queue_round_trips = 100000;
+
+// Padded elements or queues this much faster than packed ones means neighbouring ones share cache lines
+constexpr double false_sharing_threshold = 1.3;
+
+// Element taking a whole cache line, so adjacent slots are never on the same one
+struct alignas(64) PaddedValue
+{
+	uint64_t value;
+};
+
+// Baseline for the benchmarks, a std::deque behind a mutex, bounded like the candidates
+template <typename T>
+class LockedQueue
+{
+public:
+	explicit LockedQueue(size_t capacity) : capacity(capacity) {}
+
+	bool try_push(T&& value)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (items.size() >= capacity)
+			return false;
+
+		items.push_back(std::move(value));
+		return true;
+	}
+
+	bool try_pop(T& value)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (items.empty())
+			return false;
+
+		value = std::move(items.front());
+		items.pop_front();
+		return true;
+	}
+
+private:
+	std::mutex mutex;
+	std::deque<T> items;
+	size_t capacity;
+};
+
+// Bounded FIFO the checker replays histories against. A push may succeed past the capacity asked for, as candidates
+// can round it up, but may only fail once it's reached.
+struct QueueModel
+{
+	enum { Push, Pop };
+
+	std::deque<int64_t> items;
+	size_t capacity = 0;
+
+	bool apply(const HistoryOperation& op)
+	{
+		if (op.kind == Push)
+		{
+			if (!op.success)
+				return items.size() >= capacity;
+
+			items.push_back(op.value);
+			return true;
+		}
+
+		if (!op.success)
+			return items.empty();
+
+		if (items.empty() || items.front() != op.value)
+			return false;
+
+		items.pop_front();
+		return true;
+	}
+
+	auto operator<=>(const QueueModel&) const = default;
+};
+
+// Waits out a full or empty queue. Spinning only helps when there's a core for every thread.
+void queue_backoff(bool spin)
+{
+	if (!spin)
+		std::this_thread::yield();
+}
+
+template <template <typename> class Queue>
+TestResult test_try_push_pop()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Queue<MemoryCorrectnessItem> q(queue_test_capacity);
+		MemoryCorrectnessItem item;
+
+		if (q.try_pop(item))
+			return TestResult::IncorrectResults;
+
+		size_t pushed = 0;
+		while (pushed <= 2 * queue_test_capacity && q.try_push(MemoryCorrectnessItem(int(pushed))))
+			pushed += 1;
+
+		// Has to hold what was asked for, and be bounded
+		if (pushed < queue_test_capacity || pushed > 2 * queue_test_capacity)
+			return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != pushed + 1)
+			return TestResult::IncorrectObjectHandling;
+
+		for (size_t i = 0; i < pushed; i++)
+			if (!q.try_pop(item) || item.id != int(i))
+				return TestResult::IncorrectResults;
+
+		if (q.try_pop(item))
+			return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+
+		// Space freed by pops has to be reusable
+		if (!q.try_push(MemoryCorrectnessItem(42)) || !q.try_pop(item) || item.id != 42)
+			return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0 || MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	// Items are pushed as temporaries and popped into an existing item, so never need copying
+	if (MemoryCorrectnessItem::count_constructed_copy != 0 || MemoryCorrectnessItem::count_assigned_copy != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Queue>
+TestResult test_destructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Queue<MemoryCorrectnessItem> q(queue_test_capacity);
+		for (int i = 0; i < 10; i++)
+			q.try_push(MemoryCorrectnessItem(i));
+
+		if (MemoryCorrectnessItem::count_alive() != 10)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0 || MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+// Every item pushed is popped exactly once, and each consumer sees each producer's items in the order they were
+// pushed, which any FIFO has to give
+template <template <typename> class Queue>
+TestResult test_exactly_once(int producers, int consumers)
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	int total = producers * queue_items_per_producer;
+	std::vector<std::atomic<uint8_t>> times_popped(total);
+	std::atomic<int> popped = 0;
+	std::atomic<int> out_of_order = 0;
+	bool spin = max_thread_count() >= producers + consumers;
+
+	{
+		Queue<MemoryCorrectnessItem> q(queue_benchmark_capacity);
+
+		run_concurrently(producers + consumers, [&](int thread_index) {
+			if (thread_index < producers)
+			{
+				for (int i = 0; i < queue_items_per_producer; i++)
+				{
+					int id = thread_index * queue_items_per_producer + i;
+					while (!q.try_push(MemoryCorrectnessItem(id)))
+						queue_backoff(spin);
+				}
+				return;
+			}
+
+			std::vector<int> last_seen(producers, -1);
+			MemoryCorrectnessItem item;
+
+			while (popped < total)
+			{
+				if (!q.try_pop(item))
+				{
+					queue_backoff(spin);
+					continue;
+				}
+
+				popped += 1;
+				if (item.id < 0 || item.id >= total)
+				{
+					out_of_order += 1;
+					continue;
+				}
+
+				times_popped[item.id] += 1;
+
+				int producer = item.id / queue_items_per_producer;
+				if (item.id <= last_seen[producer])
+					out_of_order += 1;
+				last_seen[producer] = item.id;
+			}
+		});
+
+		for (auto& count : times_popped)
+			if (count != 1)
+				return TestResult::IncorrectResults;
+
+		if (out_of_order != 0)
+			return TestResult::IncorrectResults;
+
+		// The consumers' items went with their threads, and the queue is empty
+		if (MemoryCorrectnessItem::count_alive() != 0)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0 || MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+// Records short histories of concurrent try_push and try_pop calls on a nearly full queue and checks each against
+// a sequential FIFO. Threads past the producers and consumers alternate between pushing and popping, so a pop can
+// follow a push even when the threads don't overlap.
+template <template <typename> class Queue>
+TestResult test_linearizable(int producers, int consumers, int mixed)
+{
+	int thread_count = producers + consumers + mixed;
+
+	for (int round = 0; round < queue_histories; round++)
+	{
+		Queue<int64_t> q(queue_history_capacity);
+		HistoryClock clock;
+		std::vector<std::vector<HistoryOperation>> histories(thread_count);
+
+		run_concurrently(thread_count, [&](int thread_index) {
+			auto& history = histories[thread_index];
+			history.reserve(queue_history_operations_per_thread);
+
+			for (int i = 0; i < queue_history_operations_per_thread; i++)
+			{
+				HistoryOperation op = {};
+				op.call = clock.tick();
+
+				bool mixed_push = thread_index >= producers + consumers && i % 2 == 0;
+
+				if (thread_index < producers || mixed_push)
+				{
+					op.kind = QueueModel::Push;
+					op.value = int64_t(thread_index) * queue_history_operations_per_thread + i;
+					op.success = q.try_push(int64_t(op.value));
+				}
+				else
+				{
+					op.kind = QueueModel::Pop;
+					int64_t value = -1;
+					op.success = q.try_pop(value);
+					op.value = value;
+				}
+
+				op.ret = clock.tick();
+				history.push_back(op);
+			}
+		});
+
+		std::vector<HistoryOperation> history;
+		for (auto& thread_history : histories)
+			history.insert(history.end(), thread_history.begin(), thread_history.end());
+
+		QueueModel initial;
+		initial.capacity = queue_history_capacity;
+
+		if (!LinearizabilityChecker<QueueModel>(std::move(history)).check(initial))
+			return TestResult::IncorrectResults;
+	}
+
+	return TestResult::Pass;
+}
+
+// Items popped per second with producers pushing as fast as they can until the time's up. With no consumers, one
+// thread alternates between pushing and popping.
+template <typename Q, typename T>
+double measure_queue_throughput(Q& q, int producers, int consumers)
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::atomic<uint64_t> popped = 0;
+	std::atomic<int> producers_done = 0;
+	bool spin = max_thread_count() >= producers + consumers;
+
+	auto start = Clock::now();
+	auto deadline = start + queue_benchmark_duration;
+
+	run_concurrently(producers + consumers, [&](int thread_index) {
+		T item{};
+
+		if (consumers == 0)
+		{
+			uint64_t local_popped = 0;
+			while (Clock::now() < deadline)
+			{
+				for (uint64_t i = 0; i < 256; i++)
+					q.try_push(T{ i });
+				while (q.try_pop(item))
+					local_popped += 1;
+			}
+			popped += local_popped;
+			return;
+		}
+
+		if (thread_index < producers)
+		{
+			for (uint64_t i = 0; Clock::now() < deadline;)
+			{
+				for (uint64_t end = i + 256; i < end; i++)
+					while (!q.try_push(T{ i }))
+						queue_backoff(spin);
+			}
+			producers_done += 1;
+			return;
+		}
+
+		uint64_t local_popped = 0;
+		while (true)
+		{
+			if (q.try_pop(item))
+				local_popped += 1;
+			else if (producers_done == producers)
+			{
+				while (q.try_pop(item))
+					local_popped += 1;
+				break;
+			}
+			else
+				queue_backoff(spin);
+		}
+		popped += local_popped;
+	});
+
+	do_not_optimize(popped);
+	return double(popped) / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Round trips between pairs of threads, one pushing the time to a request queue and the other echoing it back
+// through a reply queue, all pairs sharing the two queues
+template <typename Q>
+void measure_queue_round_trips(int pairs, LatencyHistogram& histogram)
+{
+	Q requests(queue_benchmark_capacity);
+	Q replies(queue_benchmark_capacity);
+
+	std::vector<LatencyHistogram> histograms(pairs);
+	std::atomic<int> senders_done = 0;
+	bool spin = max_thread_count() >= 2 * pairs;
+
+	run_concurrently(2 * pairs, [&](int thread_index) {
+		uint64_t value = 0;
+
+		if (thread_index < pairs)
+		{
+			for (int i = 0; i < queue_round_trips; i++)
+			{
+				while (!requests.try_push(read_cycle_counter()))
+					queue_backoff(spin);
+				while (!replies.try_pop(value))
+					queue_backoff(spin);
+
+				histograms[thread_index].record(read_cycle_counter() - value);
+			}
+			senders_done += 1;
+			return;
+		}
+
+		while (true)
+		{
+			if (requests.try_pop(value))
+			{
+				while (!replies.try_push(uint64_t(value)))
+					queue_backoff(spin);
+			}
+			else if (senders_done == pairs)
+				break;
+			else
+				queue_backoff(spin);
+		}
+	});
+
+	for (const LatencyHistogram& thread_histogram : histograms)
+		histogram.merge(thread_histogram);
+}
+
+template <template <typename> class Queue>
+void benchmark_throughput(int producers, int consumers)
+{
+	Queue<uint64_t> q(queue_benchmark_capacity);
+	double items = measure_queue_throughput<Queue<uint64_t>, uint64_t>(q, producers, consumers);
+
+	LockedQueue<uint64_t> locked(queue_benchmark_capacity);
+	double locked_items = measure_queue_throughput<LockedQueue<uint64_t>, uint64_t>(locked, producers, consumers);
+
+	char name[128];
+	snprintf(name, sizeof(name), "throughput (threads: %d)", std::max(producers + consumers, 1));
+	printf("  %s: %.2f M items/s (locked std::deque: %.2f M items/s, %.2fx)\n", name, items / 1e6, locked_items / 1e6, items / locked_items);
+	record_benchmark(name, items / 1e6, "M items/s");
+}
+
+template <template <typename> class Queue>
+void benchmark_latency(int pairs)
+{
+	static LatencyHistogram histogram;
+	static LatencyHistogram locked_histogram;
+	histogram = {};
+	locked_histogram = {};
+
+	measure_queue_round_trips<Queue<uint64_t>>(pairs, histogram);
+	measure_queue_round_trips<LockedQueue<uint64_t>>(pairs, locked_histogram);
+
+	printf("  round trip latency (pairs: %d):\n", pairs);
+	output_latency("  candidate", histogram);
+	output_latency("  locked std::deque", locked_histogram);
+
+	record_benchmark("round trip latency (p50)", double(histogram.percentile(0.5)), "cycles");
+	record_benchmark("round trip latency (p99.9)", double(histogram.percentile(0.999)), "cycles");
+}
+
+// Throughput of two queues at once, each with a producer and a consumer, placed gap bytes after each other
+template <typename Q>
+double measure_pair_throughput(size_t gap)
+{
+	constexpr size_t alignment = std::max<size_t>(alignof(Q), 128);
+	size_t stride = (sizeof(Q) + gap + alignof(Q) - 1) / alignof(Q) * alignof(Q);
+
+	void* storage = ::operator new(stride + sizeof(Q), std::align_val_t(alignment));
+	Q* first = new (storage) Q(queue_benchmark_capacity);
+	Q* second = new (static_cast<char*>(storage) + stride) Q(queue_benchmark_capacity);
+
+	double items = 0;
+	run_concurrently(2, [&](int thread_index) {
+		double queue_items = measure_queue_throughput<Q, uint64_t>(thread_index == 0 ? *first : *second, 1, 1);
+		if (thread_index == 0)
+			items = queue_items;
+	});
+
+	first->~Q();
+	second->~Q();
+	::operator delete(storage, std::align_val_t(alignment));
+
+	return items * 2;
+}
+
+// Two kinds of false sharing a queue can have. Its slots can share cache lines, so the producer writing one slot
+// keeps taking the line from the consumer reading the one before, which padding each element to a line shows. And
+// the indices at the ends of the queue can share lines with whatever is next to it, which two queues placed next to
+// each other or apart shows.
+template <template <typename> class Queue>
+void benchmark_false_sharing()
+{
+	if (max_thread_count() < 2)
+	{
+		output_warning("false sharing", "can't test, needs at least 2 hardware threads");
+		return;
+	}
+
+	Queue<uint64_t> packed(queue_benchmark_capacity);
+	Queue<PaddedValue> padded(queue_benchmark_capacity);
+	double packed_items = measure_queue_throughput<Queue<uint64_t>, uint64_t>(packed, 1, 1);
+	double padded_items = measure_queue_throughput<Queue<PaddedValue>, PaddedValue>(padded, 1, 1);
+
+	printf("  false sharing (elements): %.2f M items/s, padded to a cache line %.2f M items/s (%.2fx)\n",
+		packed_items / 1e6, padded_items / 1e6, padded_items / packed_items);
+	record_benchmark("false sharing (padded / packed elements)", padded_items / packed_items, "x");
+
+	if (padded_items > packed_items * false_sharing_threshold)
+		output_warning("false sharing (elements)", "faster with padded elements, the producer and consumer are fighting over slots on the same cache line");
+
+	if (max_thread_count() < 4)
+	{
+		output_warning("false sharing (neighbours)", "can't test, needs at least 4 hardware threads");
+		return;
+	}
+
+	double adjacent_items = measure_pair_throughput<Queue<uint64_t>>(0);
+	double apart_items = measure_pair_throughput<Queue<uint64_t>>(256);
+
+	printf("  false sharing (neighbours): two adjacent queues %.2f M items/s, 256 bytes apart %.2f M items/s (%.2fx)\n",
+		adjacent_items / 1e6, apart_items / 1e6, apart_items / adjacent_items);
+	record_benchmark("false sharing (apart / adjacent queues)", apart_items / adjacent_items, "x");
+
+	if (apart_items > adjacent_items * false_sharing_threshold)
+		output_warning("false sharing (neighbours)", "faster apart, the queue's indices aren't padded from what's next to it");
+}
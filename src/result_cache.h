@@ -0,0 +1,138 @@
+#pragma once
+
+// On-disk cache of each suite's results, warnings and benchmark values, so a rerun of an unchanged candidate can
+// replay them instead of running again. Entries are keyed by a hash of the preprocessed candidate source, the
+// harness version and the options that change results. The file is plain text, one record per line:
+//
+//   <key> \t result \t <name> \t <TestResult> [\t <reason>]
+//   <key> \t warning \t <name> \t <message>
+//   <key> \t benchmark \t <name> \t <value> \t <unit>
+//   <key> \t end
+//
+// and a suite's records only count once its end line is there, so a run that crashed part way isn't replayed.
+// Later entries for a key replace earlier ones.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+struct ResultCache
+{
+	bool enabled = false;
+
+	// Ignore what's stored and run everything, replacing the entries
+	bool invalidate = false;
+
+	const char* path = nullptr;
+	std::map<std::string, std::vector<std::string>> entries;
+
+	// Keys this process ran and stored, which --repeat has to run again rather than replay
+	std::set<std::string> committed;
+
+	// Records made while a suite runs, written out when it finishes
+	bool recording = false;
+	std::string key;
+	std::vector<std::string> pending;
+};
+
+ResultCache result_cache;
+
+bool result_cache_open(const char* path, bool invalidate)
+{
+	result_cache.enabled = true;
+	result_cache.invalidate = invalidate;
+	result_cache.path = path;
+
+	FILE* file = fopen(path, "r");
+	if (file == nullptr)
+		return true;
+
+	std::map<std::string, std::vector<std::string>> incomplete;
+	std::string line;
+	char buffer[1024];
+
+	while (fgets(buffer, sizeof(buffer), file) != nullptr)
+	{
+		line += buffer;
+		if (line.back() != '\n' && !feof(file))
+			continue;
+
+		if (line.back() == '\n')
+			line.pop_back();
+
+		size_t tab = line.find('\t');
+		if (tab != std::string::npos)
+		{
+			std::string key = line.substr(0, tab);
+			std::string record = line.substr(tab + 1);
+
+			if (record == "end")
+			{
+				result_cache.entries[key] = std::move(incomplete[key]);
+				incomplete.erase(key);
+			}
+			else
+				incomplete[key].push_back(std::move(record));
+		}
+
+		line.clear();
+	}
+
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+// Records stored for a key, or null when it has to be run
+const std::vector<std::string>* result_cache_find(const std::string& key)
+{
+	if (!result_cache.enabled || result_cache.invalidate)
+		return nullptr;
+
+	if (result_cache.committed.count(key) != 0)
+		return nullptr;
+
+	auto entry = result_cache.entries.find(key);
+	return entry != result_cache.entries.end() ? &entry->second : nullptr;
+}
+
+void result_cache_begin(const std::string& key)
+{
+	result_cache.recording = result_cache.enabled;
+	result_cache.key = key;
+	result_cache.pending.clear();
+}
+
+void result_cache_add(const char* type, const char* name, const std::string& payload)
+{
+	if (!result_cache.recording)
+		return;
+
+	result_cache.pending.push_back(std::string(type) + '\t' + name + '\t' + payload);
+}
+
+void result_cache_commit()
+{
+	if (!result_cache.recording)
+		return;
+	result_cache.recording = false;
+
+	FILE* file = fopen(result_cache.path, "a");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "can't write result cache %s\n", result_cache.path);
+		return;
+	}
+
+	for (const std::string& record : result_cache.pending)
+		fprintf(file, "%s\t%s\n", result_cache.key.c_str(), record.c_str());
+	fprintf(file, "%s\tend\n", result_cache.key.c_str());
+	fclose(file);
+
+	result_cache.entries[result_cache.key] = std::move(result_cache.pending);
+	result_cache.committed.insert(result_cache.key);
+	result_cache.pending.clear();
+}
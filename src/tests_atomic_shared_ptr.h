@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+#include "concurrency_common.h"
+
+namespace tests_atomic_shared_ptr
+{
+
+template <typename ASP, typename SP> concept has_constructor_default = requires { ASP{}; };
+template <typename ASP, typename SP> concept has_load = requires(ASP a) { { a.load() } -> std::same_as<SP>; };
+template <typename ASP, typename SP> concept has_store = requires(ASP a, SP p) { a.store(p); };
+template <typename ASP, typename SP> concept has_exchange = requires(ASP a, SP p) { { a.exchange(p) } -> std::same_as<SP>; };
+template <typename ASP, typename SP> concept has_compare_exchange = requires(ASP a, SP& expected, SP desired) { { a.compare_exchange_strong(expected, desired) } -> std::same_as<bool>; };
+template <typename ASP> concept has_is_lock_free = requires(ASP a) { { a.is_lock_free() } -> std::convertible_to<bool>; };
+template <typename SP, typename T> concept has_shared_ptr_basics = requires(T* t, SP p) { SP{ t }; { p.get() } -> std::same_as<T*>; };
+
+// Number of snapshots the writer publishes while the readers run in the concurrency test
+constexpr int concurrent_writes = 20000;
+
+// How long each point of the read scaling benchmark runs for
+constexpr auto scaling_duration = std::chrono::milliseconds(100);
+
+// Time between snapshots published by the writer in the read scaling benchmark
+constexpr auto scaling_write_interval = std::chrono::microseconds(100);
+
+template <template <typename> class AtomicSharedPtr, template <typename> class SharedPtr>
+TestResult test_load_store()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		AtomicSharedPtr<MemoryCorrectnessItem> a;
+
+		if (a.load().get() != nullptr)
+			return TestResult::IncorrectResults;
+
+		a.store(SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(1)));
+
+		if (a.load().get()->id != 1)
+			return TestResult::IncorrectResults;
+
+		SharedPtr<MemoryCorrectnessItem> held = a.load();
+		a.store(SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(2)));
+
+		// The old snapshot has to stay alive for as long as a reader holds it
+		if (held.get()->id != 1 || a.load().get()->id != 2)
+			return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 2)
+			return TestResult::IncorrectObjectHandling;
+
+		held = SharedPtr<MemoryCorrectnessItem>();
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class AtomicSharedPtr, template <typename> class SharedPtr>
+TestResult test_exchange()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		AtomicSharedPtr<MemoryCorrectnessItem> a;
+		a.store(SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(1)));
+
+		SharedPtr<MemoryCorrectnessItem> old = a.exchange(SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(2)));
+
+		if (old.get()->id != 1 || a.load().get()->id != 2)
+			return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 2)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class AtomicSharedPtr, template <typename> class SharedPtr>
+TestResult test_compare_exchange()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		AtomicSharedPtr<MemoryCorrectnessItem> a;
+		a.store(SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(1)));
+
+		SharedPtr<MemoryCorrectnessItem> expected = a.load();
+
+		if (!a.compare_exchange_strong(expected, SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(2))))
+			return TestResult::IncorrectResults;
+
+		if (a.load().get()->id != 2)
+			return TestResult::IncorrectResults;
+
+		// expected still points at the first snapshot, so this has to fail and hand back the current one
+		if (a.compare_exchange_strong(expected, SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(3))))
+			return TestResult::IncorrectResults;
+
+		if (expected.get()->id != 2 || a.load().get()->id != 2)
+			return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class AtomicSharedPtr, template <typename> class SharedPtr>
+TestResult test_concurrent_readers()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	int reader_count = std::max(max_thread_count() - 1, 3);
+	std::atomic<bool> writing_done = false;
+	std::atomic<uint64_t> bad_reads = 0;
+
+	{
+		AtomicSharedPtr<MemoryCorrectnessItem> a;
+		a.store(SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(0)));
+
+		run_concurrently(reader_count + 1, [&](int thread_index) {
+			if (thread_index == 0)
+			{
+				for (int i = 1; i <= concurrent_writes; i++)
+				{
+					if (i % 2 == 0)
+					{
+						SharedPtr<MemoryCorrectnessItem> expected = a.load();
+						a.compare_exchange_strong(expected, SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(i)));
+					}
+					else
+						a.store(SharedPtr<MemoryCorrectnessItem>(new MemoryCorrectnessItem(i)));
+				}
+
+				writing_done = true;
+				return;
+			}
+
+			int last_id = 0;
+
+			while (!writing_done)
+			{
+				SharedPtr<MemoryCorrectnessItem> snapshot = a.load();
+				MemoryCorrectnessItem* item = snapshot.get();
+
+				// A snapshot destroyed while still held shows up here, and there is only one writer, so ids never go backwards
+				if (item == nullptr || item->status != MemoryCorrectnessItem::MemoryStatus::Constructed || item->id < last_id)
+					bad_reads += 1;
+				else
+					last_id = item->id;
+			}
+		});
+
+		if (bad_reads != 0)
+			return TestResult::IncorrectObjectHandling;
+
+		if (a.load().get()->id != concurrent_writes)
+			return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+// Total loads per second for reader_count readers, while a writer publishes a new snapshot every scaling_write_interval
+template <typename Atomic, typename Shared>
+double measure_loads_per_second(int reader_count)
+{
+	Atomic a;
+	a.store(Shared(new int(0)));
+
+	std::atomic<uint64_t> loads = 0;
+	auto deadline = std::chrono::steady_clock::now() + scaling_duration;
+
+	run_concurrently(reader_count + 1, [&](int thread_index) {
+		if (thread_index == 0)
+		{
+			for (int i = 1; std::chrono::steady_clock::now() < deadline; i++)
+			{
+				a.store(Shared(new int(i)));
+				std::this_thread::sleep_for(scaling_write_interval);
+			}
+			return;
+		}
+
+		uint64_t local_loads = 0;
+
+		while (std::chrono::steady_clock::now() < deadline)
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				Shared snapshot = a.load();
+				do_not_optimize(*snapshot.get());
+			}
+			local_loads += 256;
+		}
+
+		loads += local_loads;
+	});
+
+	return double(loads) / std::chrono::duration<double>(scaling_duration).count();
+}
+
+template <template <typename> class AtomicSharedPtr, template <typename> class SharedPtr>
+void benchmark_read_scaling()
+{
+	double single_thread = 0;
+
+	for (int reader_count : scaling_thread_counts())
+	{
+		double loads = measure_loads_per_second<AtomicSharedPtr<int>, SharedPtr<int>>(reader_count);
+		if (reader_count == 1)
+			single_thread = loads;
+
+		char name[128];
+		snprintf(name, sizeof(name), "load (readers: %d)", reader_count);
+
+#ifdef __cpp_lib_atomic_shared_ptr
+		double std_loads = measure_loads_per_second<std::atomic<std::shared_ptr<int>>, std::shared_ptr<int>>(reader_count);
+		printf("  %s: %.2f M/s, %.2fx of 1 reader (std::atomic<std::shared_ptr>: %.2f M/s)\n", name, loads / 1e6, loads / single_thread, std_loads / 1e6);
+#else
+		printf("  %s: %.2f M/s, %.2fx of 1 reader\n", name, loads / 1e6, loads / single_thread);
+#endif
+		record_benchmark(name, loads / 1e6, "M/s");
+	}
+}
+
+template <template <typename> class AtomicSharedPtr, template <typename> class SharedPtr>
+void run()
+{
+	using ASP = AtomicSharedPtr<MemoryCorrectnessItem>;
+	using SP = SharedPtr<MemoryCorrectnessItem>;
+
+	printf("\n%s\n-------------------------------\n", typeid(AtomicSharedPtr<int>).name());
+
+	printf("Class methods:\n");
+
+	constexpr bool can_test = has_constructor_default<ASP, SP> && has_shared_ptr_basics<SP, MemoryCorrectnessItem>;
+
+	if constexpr (has_load<ASP, SP> && has_store<ASP, SP>)
+	{
+		if constexpr (can_test)
+			output_result("load/store", test_load_store<AtomicSharedPtr, SharedPtr>);
+		else
+			output_warning("load/store", "can't test, missing requirements: constructor (default), shared pointer constructor (pointer), get");
+	}
+	else
+		output_warning("load/store", "not implemented");
+
+	if constexpr (has_exchange<ASP, SP>)
+	{
+		if constexpr (can_test && has_load<ASP, SP> && has_store<ASP, SP>)
+			output_result("exchange", test_exchange<AtomicSharedPtr, SharedPtr>);
+		else
+			output_warning("exchange", "can't test, missing requirements: load/store");
+	}
+	else
+		output_warning("exchange", "not implemented");
+
+	if constexpr (has_compare_exchange<ASP, SP>)
+	{
+		if constexpr (can_test && has_load<ASP, SP> && has_store<ASP, SP>)
+			output_result("compare_exchange_strong", test_compare_exchange<AtomicSharedPtr, SharedPtr>);
+		else
+			output_warning("compare_exchange_strong", "can't test, missing requirements: load/store");
+	}
+	else
+		output_warning("compare_exchange_strong", "not implemented");
+
+	if constexpr (can_test && has_load<ASP, SP> && has_store<ASP, SP> && has_compare_exchange<ASP, SP>)
+		output_result("concurrent readers and writer", test_concurrent_readers<AtomicSharedPtr, SharedPtr>);
+	else
+		output_warning("concurrent readers and writer", "can't test, missing requirements: load/store, compare_exchange_strong");
+
+	if constexpr (has_is_lock_free<ASP>)
+	{
+		ASP a;
+		printf("  is_lock_free: %s\n", a.is_lock_free() ? "yes" : "no");
+	}
+	else
+		output_warning("is_lock_free", "not implemented");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (can_test && has_load<ASP, SP> && has_store<ASP, SP>)
+		run_benchmark("read scaling", benchmark_read_scaling<AtomicSharedPtr, SharedPtr>);
+	else
+		output_warning("read scaling", "can't test, missing requirements: load/store");
+
+	printf("\n");
+}
+
+}
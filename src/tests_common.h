@@ -1,5 +1,14 @@
 #pragma once
 
+#include <type_traits>
+
+#include "harness_options.h"
+#include "result_cache.h"
+
+#ifdef TEST_HARNESS_ALLOCATION_PROFILER
+#include "counted_malloc.h"
+#endif
+
 enum class TestResult
 {
 	IncorrectResults,
@@ -9,21 +18,115 @@ enum class TestResult
 	Pass
 };
 
-void output_result(const char* name, TestResult result)
+const char* result_name(TestResult result)
 {
 	if (result == TestResult::Pass)
-		printf("  %s: \033[32mpass\033[0m\n", name);
+		return "pass";
 	else if (result == TestResult::SuboptimalObjectHandling)
-		printf("  %s: \033[32mpass, suboptimal copies/moves\033[0m\n", name);
+		return "pass, suboptimal copies/moves";
 	else if (result == TestResult::IncorrectObjectHandling)
-		printf("  %s: \033[33mincorrect object handling\033[0m\n", name);
+		return "incorrect object handling";
 	else if (result == TestResult::LeaksMemory)
-		printf("  %s: \033[33mleaks memory\033[0m\n", name);
-	else if (result == TestResult::IncorrectResults)
-		printf("  %s: \033[31mfail\033[0m\n", name);
+		return "leaks memory";
+	else
+		return "fail";
+}
+
+// The reason, if there is one, is shown with the result rather than as a separate warning
+void output_result(const char* name, TestResult result, const char* reason = nullptr)
+{
+	if (!test_selected(name))
+		return;
+
+	result_cache_add("result", name, reason == nullptr ? std::to_string(int(result)) : std::to_string(int(result)) + "\t" + reason);
+
+	if (harness_options.format == OutputFormat::Json)
+	{
+		output_json_line_start("result", name);
+		fprintf(json_output, ", \"result\": ");
+		output_json_string(result_name(result));
+		if (reason != nullptr)
+		{
+			fprintf(json_output, ", \"reason\": ");
+			output_json_string(reason);
+		}
+		fprintf(json_output, "}\n");
+	}
+	else
+	{
+		const char* colour = "\033[31m";
+		if (result == TestResult::Pass || result == TestResult::SuboptimalObjectHandling)
+			colour = "\033[32m";
+		else if (result == TestResult::IncorrectObjectHandling || result == TestResult::LeaksMemory)
+			colour = "\033[33m";
+
+		printf("  %s: %s%s\033[0m", name, colour, result_name(result));
+		if (reason != nullptr)
+			printf(" (%s)", reason);
+		printf("\n");
+	}
+
+#ifdef TEST_HARNESS_ALLOCATION_PROFILER
+	// Where a failing test allocated, and what it didn't free
+	if (result != TestResult::Pass)
+		profiler_output_report();
+	profiler_reset();
+#endif
+}
+
+// Runs the test only when it's selected, so one test can be run on its own under a profiler
+template <typename Test> requires std::is_invocable_r_v<TestResult, Test&>
+void output_result(const char* name, Test&& test)
+{
+	if (test_selected(name))
+		output_result(name, test());
 }
 
 void output_warning(const char* name, const char* warning)
 {
-	printf("  %s: \033[33m%s\033[0m\n", name, warning);
-}
\ No newline at end of file
+	if (!test_selected(name))
+		return;
+
+	result_cache_add("warning", name, warning);
+
+	if (harness_options.format == OutputFormat::Json)
+	{
+		output_json_line_start("warning", name);
+		fprintf(json_output, ", \"warning\": ");
+		output_json_string(warning);
+		fprintf(json_output, "}\n");
+	}
+	else
+		printf("  %s: \033[33m%s\033[0m\n", name, warning);
+}
+
+// Benchmarks are selected by the same globs as tests
+template <typename F>
+void run_benchmark(const char* name, F&& benchmark)
+{
+	if (test_selected(name))
+		benchmark();
+}
+
+// Whether the compiler can evaluate a test, which it can't if the test hits undefined behaviour, leaves an
+// allocation unfreed or calls something that isn't constexpr
+template <auto Test> concept constant_evaluable = requires { typename std::integral_constant<TestResult, Test()>; };
+
+template <auto Test>
+constexpr bool constexpr_passes()
+{
+	return Test() == TestResult::Pass || Test() == TestResult::SuboptimalObjectHandling;
+}
+
+// Reports a test the compiler ran, so only its result is left to print
+template <auto Test>
+void output_constexpr_result(const char* name)
+{
+	if constexpr (constant_evaluable<Test>)
+	{
+		constexpr TestResult result = Test();
+		output_result(name, result);
+	}
+	else
+		output_result(name, TestResult::IncorrectResults, "not a constant expression, build with TEST_HARNESS_CONSTEXPR_GATE for the compiler's reason");
+}
@@ -0,0 +1,442 @@
+#pragma once
+
+// Candidates are concurrent hash maps, default constructed, with bool insert(K, V), bool find(const K&, V&), which
+// copies the value out rather than handing back a pointer another thread could erase from under the caller, and
+// bool erase(const K&). Values erased while another thread is copying them out have to stay alive until it's done.
+// Copying from one already destroyed counts as an error on MemoryCorrectnessItem, as its destructor marks it deleted
+// and clears its token, unless the memory has already been reused for another item, so this catches most but not
+// all such races. Values may be destroyed some time after they're erased, as with epoch or RCU style reclamation,
+// so counts are only checked once the map is gone.
+
+#include <cstdio>
+#include <cstdint>
+#include <typeinfo>
+#include <random>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+#include "concurrency_common.h"
+
+namespace tests_concurrent_map
+{
+
+template <typename Map, typename K, typename V> concept has_insert = requires(Map m) { { m.insert(K{}, V{}) } -> std::same_as<bool>; };
+template <typename Map, typename K, typename V> concept has_find = requires(Map m, K k, V& v) { { m.find(k, v) } -> std::same_as<bool>; };
+template <typename Map, typename K> concept has_erase = requires(Map m, K k) { { m.erase(k) } -> std::same_as<bool>; };
+
+// Optional: calls func on the value in place, atomically with respect to other updates of the key
+template <typename Map, typename K, typename V> concept has_update = requires(Map m, K k, void (*func)(V&)) { { m.update(k, func) } -> std::same_as<bool>; };
+
+// Keys the threads of the contention tests and benchmarks pick from, few enough that they keep meeting on the same ones
+constexpr int contention_keys = 1024;
+
+// Operations each thread does in the insert/find/erase contention test
+constexpr int contention_operations_per_thread = 200000;
+
+// Keys, and updates of each key by every thread, in the update test
+constexpr int update_keys = 64;
+constexpr int updates_per_thread = 2000;
+
+// Threads in the contention tests, at least this many even with fewer cores
+constexpr int contention_min_threads = 4;
+
+constexpr int benchmark_keys = 1 << 14;
+constexpr auto benchmark_duration = std::chrono::milliseconds(100);
+
+// Percentage of operations that are finds in each mixed benchmark, the rest split evenly between inserts and erases
+constexpr int benchmark_read_percentages[] = { 99, 90, 50 };
+
+// Baseline with a single reader-writer lock, which readers share but writers serialise on
+template <typename K, typename V>
+class SharedMutexMap
+{
+public:
+	bool insert(K key, V value)
+	{
+		std::unique_lock lock(mutex);
+		return map.emplace(std::move(key), std::move(value)).second;
+	}
+
+	bool find(const K& key, V& value)
+	{
+		std::shared_lock lock(mutex);
+		auto found = map.find(key);
+		if (found == map.end())
+			return false;
+
+		value = found->second;
+		return true;
+	}
+
+	bool erase(const K& key)
+	{
+		std::unique_lock lock(mutex);
+		return map.erase(key) != 0;
+	}
+
+private:
+	std::shared_mutex mutex;
+	std::unordered_map<K, V> map;
+};
+
+// Baseline split into stripes by hash, each a map behind its own mutex on its own cache line
+template <typename K, typename V>
+class StripedMap
+{
+public:
+	bool insert(K key, V value)
+	{
+		Stripe& stripe = stripe_for(key);
+		std::lock_guard lock(stripe.mutex);
+		return stripe.map.emplace(std::move(key), std::move(value)).second;
+	}
+
+	bool find(const K& key, V& value)
+	{
+		Stripe& stripe = stripe_for(key);
+		std::lock_guard lock(stripe.mutex);
+		auto found = stripe.map.find(key);
+		if (found == stripe.map.end())
+			return false;
+
+		value = found->second;
+		return true;
+	}
+
+	bool erase(const K& key)
+	{
+		Stripe& stripe = stripe_for(key);
+		std::lock_guard lock(stripe.mutex);
+		return stripe.map.erase(key) != 0;
+	}
+
+private:
+	struct alignas(64) Stripe
+	{
+		std::mutex mutex;
+		std::unordered_map<K, V> map;
+	};
+
+	// The identity hash of integers would put consecutive keys on consecutive stripes anyway, so this mixes the bits
+	// to keep the stripe independent of the bucket within it
+	Stripe& stripe_for(const K& key)
+	{
+		uint64_t hash = uint64_t(std::hash<K>()(key)) * 0x9e3779b97f4a7c15;
+		return stripes[hash >> 58];
+	}
+
+	std::array<Stripe, 64> stripes;
+};
+
+template <template <typename, typename> class HashMap>
+TestResult test_insert_find_erase()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		HashMap<int, MemoryCorrectnessItem> m;
+		MemoryCorrectnessItem item;
+
+		for (int i = 0; i < 100; i++)
+			if (!m.insert(i, MemoryCorrectnessItem(i)))
+				return TestResult::IncorrectResults;
+
+		if (m.insert(42, MemoryCorrectnessItem(-1)))
+			return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 100; i++)
+			if (!m.find(i, item) || item.id != i)
+				return TestResult::IncorrectResults;
+
+		if (m.find(100, item))
+			return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 100; i += 2)
+			if (!m.erase(i))
+				return TestResult::IncorrectResults;
+
+		if (m.erase(0))
+			return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 100; i++)
+			if (m.find(i, item) != (i % 2 == 1))
+				return TestResult::IncorrectResults;
+
+		if (!m.insert(0, MemoryCorrectnessItem(1000)) || !m.find(0, item) || item.id != 1000)
+			return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0 || MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename, typename> class HashMap>
+TestResult test_destructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		HashMap<int, MemoryCorrectnessItem> m;
+		for (int i = 0; i < 1000; i++)
+			m.insert(i, MemoryCorrectnessItem(i));
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0 || MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+// Threads insert, find and erase random keys from a small set, each counting its successful inserts less its
+// successful erases of every key. Whatever order they took effect in, each key's total has to come to 1 if it's
+// still there and 0 if not, so an insert or erase that was lost, or reported success twice, shows.
+template <template <typename, typename> class HashMap>
+TestResult test_contention(int thread_count)
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	std::vector<std::vector<int>> balances(thread_count, std::vector<int>(contention_keys));
+	std::atomic<int> wrong_values = 0;
+
+	{
+		HashMap<int, MemoryCorrectnessItem> m;
+
+		run_concurrently(thread_count, [&](int thread_index) {
+			std::mt19937 rng(harness_options.seed + uint32_t(thread_index));
+			std::vector<int>& balance = balances[thread_index];
+			MemoryCorrectnessItem item;
+
+			for (int i = 0; i < contention_operations_per_thread; i++)
+			{
+				int key = int(rng() % contention_keys);
+
+				switch (rng() % 3)
+				{
+				case 0:
+					if (m.insert(key, MemoryCorrectnessItem(key)))
+						balance[key] += 1;
+					break;
+				case 1:
+					if (m.find(key, item) && item.id != key)
+						wrong_values += 1;
+					break;
+				case 2:
+					if (m.erase(key))
+						balance[key] -= 1;
+					break;
+				}
+			}
+		});
+
+		if (wrong_values != 0)
+			return TestResult::IncorrectResults;
+
+		MemoryCorrectnessItem item;
+		for (int key = 0; key < contention_keys; key++)
+		{
+			int total = 0;
+			for (const std::vector<int>& balance : balances)
+				total += balance[key];
+
+			if (total != 0 && total != 1)
+				return TestResult::IncorrectResults;
+
+			bool found = m.find(key, item);
+			if (found != (total == 1) || (found && item.id != key))
+				return TestResult::IncorrectResults;
+		}
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0 || MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+// Every thread increments the id of every key in place, and none of the increments can be lost
+template <template <typename, typename> class HashMap>
+TestResult test_update(int thread_count)
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		HashMap<int, MemoryCorrectnessItem> m;
+		for (int key = 0; key < update_keys; key++)
+			m.insert(key, MemoryCorrectnessItem(0));
+
+		std::atomic<int> missing = 0;
+
+		run_concurrently(thread_count, [&](int thread_index) {
+			for (int i = 0; i < updates_per_thread; i++)
+				for (int key = 0; key < update_keys; key++)
+					if (!m.update(key, [](MemoryCorrectnessItem& item) { item.id += 1; }))
+						missing += 1;
+		});
+
+		if (missing != 0 || m.update(update_keys, [](MemoryCorrectnessItem& item) { item.id += 1; }))
+			return TestResult::IncorrectResults;
+
+		MemoryCorrectnessItem item;
+		for (int key = 0; key < update_keys; key++)
+			if (!m.find(key, item) || item.id != thread_count * updates_per_thread)
+				return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0 || MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+// Operations per second with thread_count threads on a map starting half full, read_percent of them finds and the
+// rest inserts and erases in equal numbers, so it stays about half full
+template <typename Map>
+double measure_mixed_operations(int thread_count, int read_percent)
+{
+	using Clock = std::chrono::steady_clock;
+
+	Map m;
+	for (int key = 0; key < benchmark_keys; key += 2)
+		m.insert(key, uint64_t(key));
+
+	std::atomic<uint64_t> operations = 0;
+
+	auto start = Clock::now();
+	auto deadline = start + benchmark_duration;
+
+	run_concurrently(thread_count, [&](int thread_index) {
+		std::mt19937 rng(harness_options.seed + uint32_t(thread_index));
+		uint64_t value = 0;
+		uint64_t local_operations = 0;
+
+		while (Clock::now() < deadline)
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				uint32_t random = rng();
+				int key = int(random % benchmark_keys);
+				int percent = int((random >> 16) % 100);
+
+				if (percent < read_percent)
+					do_not_optimize(m.find(key, value));
+				else if (percent % 2 == 0)
+					do_not_optimize(m.insert(key, uint64_t(key)));
+				else
+					do_not_optimize(m.erase(key));
+			}
+			local_operations += 256;
+		}
+
+		operations += local_operations;
+	});
+
+	return double(operations) / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+template <template <typename, typename> class HashMap>
+void benchmark_mixed(int read_percent)
+{
+	printf("  %d%% finds, %d%% inserts and erases:\n", read_percent, 100 - read_percent);
+
+	double single_thread = 0;
+
+	for (int thread_count : scaling_thread_counts())
+	{
+		double operations = measure_mixed_operations<HashMap<int, uint64_t>>(thread_count, read_percent);
+		double shared_mutex_operations = measure_mixed_operations<SharedMutexMap<int, uint64_t>>(thread_count, read_percent);
+		double striped_operations = measure_mixed_operations<StripedMap<int, uint64_t>>(thread_count, read_percent);
+		if (thread_count == 1)
+			single_thread = operations;
+
+		char name[128];
+		snprintf(name, sizeof(name), "mixed %d/%d (threads: %d)", read_percent, 100 - read_percent, thread_count);
+		printf("    threads: %d: %.2f M ops/s, %.2fx of 1 thread (std::shared_mutex map: %.2f M ops/s, striped map: %.2f M ops/s)\n",
+			thread_count, operations / 1e6, operations / single_thread, shared_mutex_operations / 1e6, striped_operations / 1e6);
+		record_benchmark(name, operations / 1e6, "M ops/s");
+	}
+}
+
+template <template <typename, typename> class HashMap>
+void run()
+{
+	using MapItem = HashMap<int, MemoryCorrectnessItem>;
+
+	printf("\n%s\n-------------------------------\n", typeid(HashMap<int, int>).name());
+
+	printf("Class methods:\n");
+
+	constexpr bool can_test = has_insert<MapItem, int, MemoryCorrectnessItem> && has_find<MapItem, int, MemoryCorrectnessItem> &&
+		has_erase<MapItem, int>;
+
+	if constexpr (can_test)
+		output_result("insert/find/erase", test_insert_find_erase<HashMap>);
+	else
+		output_warning("insert/find/erase", "not implemented");
+
+	// The names stay the same on every machine, so results can be compared, and the thread count is printed instead
+	int contention_threads = std::max(max_thread_count(), contention_min_threads);
+
+	if constexpr (can_test)
+	{
+		output_result("destructor", test_destructor<HashMap>);
+		if (test_selected("insert/find/erase contention") || test_selected("update contention"))
+			printf("  contention tests run with %d threads\n", contention_threads);
+		output_result("insert/find/erase contention", [&] { return test_contention<HashMap>(contention_threads); });
+
+		if constexpr (has_update<MapItem, int, MemoryCorrectnessItem>)
+			output_result("update contention", [&] { return test_update<HashMap>(contention_threads); });
+		else
+			output_warning("update contention", "not implemented");
+	}
+	else
+	{
+		output_warning("destructor", "can't test, missing requirements: insert, find, erase");
+		output_warning("insert/find/erase contention", "can't test, missing requirements: insert, find, erase");
+		output_warning("update contention", "can't test, missing requirements: insert, find, erase");
+	}
+
+	printf("Benchmarks:\n");
+
+	for (int read_percent : benchmark_read_percentages)
+	{
+		char name[128];
+		snprintf(name, sizeof(name), "mixed %d/%d", read_percent, 100 - read_percent);
+
+		if constexpr (can_test)
+			run_benchmark(name, [&] { benchmark_mixed<HashMap>(read_percent); });
+		else
+			output_warning(name, "can't test, missing requirements: insert, find, erase");
+	}
+
+	printf("\n");
+}
+
+}
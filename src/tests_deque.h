@@ -0,0 +1,438 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <deque>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+
+namespace tests_deque
+{
+
+template <typename Deq, typename T> concept has_push_back = requires(Deq d) { d.push_back(T{}); };
+template <typename Deq, typename T> concept has_push_front = requires(Deq d) { d.push_front(T{}); };
+template <typename Deq> concept has_pop_back = requires(Deq d) { d.pop_back(); };
+template <typename Deq> concept has_pop_front = requires(Deq d) { d.pop_front(); };
+template <typename Deq> concept has_size = requires(Deq d) { { d.size() } -> std::same_as<size_t>; };
+template <typename Deq> concept has_empty = requires(Deq d) { { d.empty() } -> std::same_as<bool>; };
+template <typename Deq, typename T> concept has_operator_sq_bk = requires(Deq d) { { d[0] } -> std::same_as<T&>; };
+template <typename Deq, typename T> concept has_front = requires(Deq d) { { d.front() } -> std::same_as<T&>; };
+template <typename Deq, typename T> concept has_back = requires(Deq d) { { d.back() } -> std::same_as<T&>; };
+
+// Queue depths the producer/consumer benchmark is run at, from cache resident to well out of cache
+constexpr int benchmark_depths[] = { 16, 1024, 65536, 1048576 };
+
+// Operations timed at each depth
+constexpr int benchmark_operations = 100000;
+
+template <template <typename> class Deque>
+TestResult test_push_back()
+{
+	{
+		Deque<int> d;
+
+		for (int i = 0; i < 100; i++)
+			d.push_back(i);
+
+		if (d.size() != 100) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 100; i++)
+			if (d[i] != i) return TestResult::IncorrectResults;
+	}
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Deque<MemoryCorrectnessItem> d;
+
+		for (int i = 0; i < 100; i++)
+			d.push_back(MemoryCorrectnessItem{ i });
+
+		if (MemoryCorrectnessItem::count_alive() != 100) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Deque>
+TestResult test_push_front()
+{
+	{
+		Deque<int> d;
+
+		for (int i = 0; i < 100; i++)
+			d.push_front(i);
+
+		if (d.size() != 100) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 100; i++)
+			if (d[i] != 99 - i) return TestResult::IncorrectResults;
+	}
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Deque<MemoryCorrectnessItem> d;
+
+		for (int i = 0; i < 100; i++)
+			d.push_front(MemoryCorrectnessItem{ i });
+
+		if (MemoryCorrectnessItem::count_alive() != 100) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Deque>
+TestResult test_pop_back()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Deque<MemoryCorrectnessItem> d;
+
+		for (int i = 0; i < 10; i++)
+			d.push_back(MemoryCorrectnessItem{ i });
+
+		d.pop_back();
+
+		if (d.size() != 9) return TestResult::IncorrectResults;
+		if (d[8].id != 8) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 9) return TestResult::IncorrectObjectHandling;
+
+		while (d.size() > 0)
+			d.pop_back();
+
+		if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Deque>
+TestResult test_pop_front()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Deque<MemoryCorrectnessItem> d;
+
+		for (int i = 0; i < 10; i++)
+			d.push_back(MemoryCorrectnessItem{ i });
+
+		d.pop_front();
+
+		if (d.size() != 9) return TestResult::IncorrectResults;
+		if (d[0].id != 1) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 9) return TestResult::IncorrectObjectHandling;
+
+		while (d.size() > 0)
+			d.pop_front();
+
+		if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Deque>
+TestResult test_empty()
+{
+	Deque<int> d;
+
+	if (!d.empty()) return TestResult::IncorrectResults;
+
+	d.push_back(1);
+	if (d.empty()) return TestResult::IncorrectResults;
+
+	d.pop_front();
+	if (!d.empty()) return TestResult::IncorrectResults;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Deque>
+TestResult test_front_back()
+{
+	Deque<int> d;
+
+	d.push_back(2);
+	d.push_front(1);
+	d.push_back(3);
+
+	if (d.front() != 1) return TestResult::IncorrectResults;
+	if (d.back() != 3) return TestResult::IncorrectResults;
+
+	// Make sure we're returning them by reference
+	d.front() = 69;
+	d.back() = 42;
+	if (d[0] != 69 || d[2] != 42) return TestResult::IncorrectResults;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Deque>
+TestResult test_growth()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Deque<MemoryCorrectnessItem> d;
+
+		// Grow at both ends at once, then wrap round by consuming from the front while producing at the back
+		for (int i = 1; i <= 5000; i++)
+		{
+			d.push_back(MemoryCorrectnessItem{ i });
+			d.push_front(MemoryCorrectnessItem{ -i });
+		}
+
+		if (d.size() != 10000) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 10000; i++)
+		{
+			int expected = i < 5000 ? i - 5000 : i - 4999;
+			if (d[i].id != expected) return TestResult::IncorrectResults;
+		}
+
+		for (int i = 0; i < 20000; i++)
+		{
+			d.push_back(MemoryCorrectnessItem{ 5001 + i });
+			d.pop_front();
+		}
+
+		if (d.size() != 10000) return TestResult::IncorrectResults;
+		if (d[0].id != 15001 || d[9999].id != 25000) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 10000) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+// References to elements have to survive pushes at either end, as they do for std::deque but not for a ring buffer
+template <template <typename> class Deque>
+TestResult test_reference_stability()
+{
+	Deque<int> d;
+
+	for (int i = 0; i < 10; i++)
+		d.push_back(i);
+
+	int* first = &d[0];
+	int* last = &d[9];
+
+	for (int i = 0; i < 10000; i++)
+	{
+		d.push_back(i);
+		d.push_front(i);
+	}
+
+	if (first != &d[10000] || last != &d[10009])
+		return TestResult::IncorrectResults;
+
+	if (*first != 0 || *last != 9)
+		return TestResult::IncorrectResults;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Deque>
+TestResult test_destructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Deque<MemoryCorrectnessItem> d;
+		d.push_back(MemoryCorrectnessItem{});
+		d.push_front(MemoryCorrectnessItem{});
+	}
+
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+// Average number of consecutive elements that are also adjacent in memory, which is the block size for a block based deque
+template <typename Deq>
+double average_contiguous_run(Deq& d, int count)
+{
+	int runs = 1;
+
+	for (int i = 1; i < count; i++)
+		if (&d[i] != &d[i - 1] + 1)
+			runs += 1;
+
+	return double(count) / runs;
+}
+
+// ns per push_back + pop_front pair with the queue holding depth elements
+template <typename Deq>
+double producer_consumer_ns(int depth)
+{
+	Deq d;
+
+	for (int i = 0; i < depth; i++)
+		d.push_back(i);
+
+	return benchmark_ns([&] {
+		for (int i = 0; i < benchmark_operations; i++)
+		{
+			d.push_back(i);
+			do_not_optimize(d.front());
+			d.pop_front();
+		}
+	}) / benchmark_operations;
+}
+
+template <template <typename> class Deque>
+void benchmark_producer_consumer()
+{
+	Deque<int> d;
+	std::deque<int> std_d;
+
+	for (int i = 0; i < 65536; i++)
+	{
+		d.push_back(i);
+		std_d.push_back(i);
+	}
+
+	double contiguous_run = average_contiguous_run(d, 65536);
+	printf("  contiguous run (elements per block): %.1f (std::deque: %.1f)\n", contiguous_run, average_contiguous_run(std_d, 65536));
+	record_benchmark("contiguous run (elements per block)", contiguous_run, "elements");
+
+	for (int depth : benchmark_depths)
+	{
+		char name[128];
+		snprintf(name, sizeof(name), "push_back + pop_front (depth %d)", depth);
+
+		double ns = producer_consumer_ns<Deque<int>>(depth);
+		double std_ns = producer_consumer_ns<std::deque<int>>(depth);
+		printf("  %s: %.2f ns/op (std::deque: %.2f ns/op, %.2fx)\n", name, ns, std_ns, std_ns / ns);
+		record_benchmark(name, ns, "ns/op");
+	}
+}
+
+template <template <typename> class Deque>
+void run()
+{
+	using DeqInt = Deque<int>;
+
+	printf("\n%s\n-------------------------------\n", typeid(DeqInt).name());
+
+	printf("Class methods:\n");
+
+	if constexpr (has_push_back<DeqInt, int>)
+	{
+		if constexpr (has_size<DeqInt> && has_operator_sq_bk<DeqInt, int>)
+			output_result("push_back", test_push_back<Deque>);
+		else
+			output_warning("push_back", "can't test, missing requirements: size, operator[]");
+	}
+	else
+		output_warning("push_back", "not implemented");
+
+	if constexpr (has_push_front<DeqInt, int>)
+	{
+		if constexpr (has_size<DeqInt> && has_operator_sq_bk<DeqInt, int>)
+			output_result("push_front", test_push_front<Deque>);
+		else
+			output_warning("push_front", "can't test, missing requirements: size, operator[]");
+	}
+	else
+		output_warning("push_front", "not implemented");
+
+	if constexpr (has_pop_back<DeqInt>)
+	{
+		if constexpr (has_push_back<DeqInt, int> && has_size<DeqInt> && has_operator_sq_bk<DeqInt, int>)
+			output_result("pop_back", test_pop_back<Deque>);
+		else
+			output_warning("pop_back", "can't test, missing requirements: push_back, size, operator[]");
+	}
+	else
+		output_warning("pop_back", "not implemented");
+
+	if constexpr (has_pop_front<DeqInt>)
+	{
+		if constexpr (has_push_back<DeqInt, int> && has_size<DeqInt> && has_operator_sq_bk<DeqInt, int>)
+			output_result("pop_front", test_pop_front<Deque>);
+		else
+			output_warning("pop_front", "can't test, missing requirements: push_back, size, operator[]");
+	}
+	else
+		output_warning("pop_front", "not implemented");
+
+	if constexpr (has_empty<DeqInt>)
+	{
+		if constexpr (has_push_back<DeqInt, int> && has_pop_front<DeqInt>)
+			output_result("empty", test_empty<Deque>);
+		else
+			output_warning("empty", "can't test, missing requirements: push_back, pop_front");
+	}
+	else
+		output_warning("empty", "not implemented");
+
+	if constexpr (has_front<DeqInt, int> && has_back<DeqInt, int>)
+	{
+		if constexpr (has_push_back<DeqInt, int> && has_push_front<DeqInt, int> && has_operator_sq_bk<DeqInt, int>)
+			output_result("front/back", test_front_back<Deque>);
+		else
+			output_warning("front/back", "can't test, missing requirements: push_back, push_front, operator[]");
+	}
+	else
+		output_warning("front/back", "not implemented");
+
+	constexpr bool has_both_ends = has_push_back<DeqInt, int> && has_push_front<DeqInt, int> && has_pop_front<DeqInt> && has_size<DeqInt> && has_operator_sq_bk<DeqInt, int>;
+
+	if constexpr (has_both_ends)
+		output_result("growth at both ends", test_growth<Deque>);
+	else
+		output_warning("growth at both ends", "can't test, missing requirements: push_back, push_front, pop_front, size, operator[]");
+
+	if constexpr (has_both_ends)
+		output_result("reference stability", test_reference_stability<Deque>);
+	else
+		output_warning("reference stability", "can't test, missing requirements: push_back, push_front, pop_front, size, operator[]");
+
+	if constexpr (has_push_back<DeqInt, int> && has_push_front<DeqInt, int>)
+		output_result("(destructor)", test_destructor<Deque>);
+	else
+		output_warning("(destructor)", "can't test, missing requirements: push_back, push_front");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (has_push_back<DeqInt, int> && has_pop_front<DeqInt> && has_front<DeqInt, int> && has_operator_sq_bk<DeqInt, int>)
+		run_benchmark("producer/consumer", benchmark_producer_consumer<Deque>);
+	else
+		output_warning("producer/consumer", "can't test, missing requirements: push_back, pop_front, front, operator[]");
+
+	printf("\n");
+}
+
+}
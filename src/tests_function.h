@@ -0,0 +1,378 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <functional>
+#include <utility>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+
+namespace tests_function
+{
+
+// Callable with a MemoryCorrectnessItem capture, so the stored copy can be tracked through copies, moves and destruction
+struct ItemCallable
+{
+	MemoryCorrectnessItem item;
+
+	int operator()(int x) { return item.id + x; }
+};
+
+// Same, but too big for any reasonable inline buffer
+struct LargeItemCallable
+{
+	MemoryCorrectnessItem item;
+	char padding[256] = {};
+
+	int operator()(int x) { return item.id + x; }
+};
+
+// Callable with a capture of exactly the given size, for finding where the candidate starts to allocate
+template <size_t Size>
+struct SizedCallable
+{
+	char data[Size];
+
+	int operator()(int x) { return x + data[0]; }
+};
+
+template <typename Func> concept has_constructor_default = requires { Func{}; };
+template <typename Func> concept has_constructor_callable = requires { Func{ ItemCallable{} }; };
+template <typename Func> concept has_call = requires(Func f) { { f(0) } -> std::same_as<int>; };
+template <typename Func> concept has_operator_bool = requires(Func f) { { static_cast<bool>(f) } -> std::same_as<bool>; };
+
+// Calls made per sample when timing invocation
+constexpr int benchmark_calls = 1000000;
+
+template <template <typename> class Function>
+TestResult test_constructor_default()
+{
+	counted_malloc_reset();
+
+	{
+		Function<int(int)> f{};
+
+		if constexpr (has_operator_bool<Function<int(int)>>)
+			if (static_cast<bool>(f)) return TestResult::IncorrectResults;
+	}
+
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Function>
+TestResult test_constructor_callable()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Function<int(int)> f{ ItemCallable{ 42 } };
+
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+		if (f(1) != 43) return TestResult::IncorrectResults;
+
+		if constexpr (has_operator_bool<Function<int(int)>>)
+			if (!static_cast<bool>(f)) return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Function>
+TestResult test_call_state()
+{
+	Function<int(int)> f{ [total = 0](int x) mutable { total += x; return total; } };
+
+	f(1);
+	f(2);
+	if (f(3) != 6) return TestResult::IncorrectResults;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Function>
+TestResult test_copy_constructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Function<int(int)> f{ ItemCallable{ 42 } };
+		Function<int(int)> g{ f };
+
+		if (MemoryCorrectnessItem::count_alive() != 2) return TestResult::IncorrectObjectHandling;
+		if (f(1) != 43 || g(1) != 43) return TestResult::IncorrectResults;
+
+		// Each copy has its own state
+		Function<int(int)> counter{ [total = 0](int x) mutable { total += x; return total; } };
+		counter(10);
+		Function<int(int)> counter_copy{ counter };
+		counter(1);
+		if (counter_copy(1) != 11) return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Function>
+TestResult test_move_constructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Function<int(int)> f{ ItemCallable{ 42 } };
+		Function<int(int)> g{ std::move(f) };
+
+		if (g(1) != 43) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Function>
+TestResult test_copy_assignment()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Function<int(int)> f{ ItemCallable{ 42 } };
+		Function<int(int)> g{ ItemCallable{ 7 } };
+
+		g = f;
+
+		if (MemoryCorrectnessItem::count_alive() != 2) return TestResult::IncorrectObjectHandling;
+		if (f(1) != 43 || g(1) != 43) return TestResult::IncorrectResults;
+
+		// Assigning a callable that needs more room than the one it replaces
+		Function<int(int)> big{ LargeItemCallable{ 100 } };
+		g = big;
+
+		if (MemoryCorrectnessItem::count_alive() != 3) return TestResult::IncorrectObjectHandling;
+		if (g(1) != 101) return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Function>
+TestResult test_move_assignment()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Function<int(int)> f{ ItemCallable{ 42 } };
+		Function<int(int)> g{ ItemCallable{ 7 } };
+
+		g = std::move(f);
+
+		if (g(1) != 43) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Function, size_t Size>
+bool allocates_for_capture()
+{
+	size_t allocations = counted_malloc_allocations;
+	Function<int(int)> f{ SizedCallable<Size>{} };
+	do_not_optimize(f);
+	return counted_malloc_allocations != allocations;
+}
+
+// Smallest of the capture sizes that makes the candidate allocate, or 0 if none of them do
+template <template <typename> class Function, size_t... Sizes>
+size_t first_allocating_capture()
+{
+	bool (*allocates[])() = { allocates_for_capture<Function, Sizes>... };
+	size_t sizes[] = { Sizes... };
+
+	for (size_t i = 0; i < sizeof...(Sizes); i++)
+		if (allocates[i]())
+			return sizes[i];
+
+	return 0;
+}
+
+[[gnu::noinline]] int direct_call(int x)
+{
+	return x + 1;
+}
+
+struct VirtualBase
+{
+	virtual ~VirtualBase() = default;
+	virtual int call(int x) = 0;
+};
+
+// Not inlinable, like direct_call, so that speculative devirtualisation can't fold the loop away
+struct VirtualDerived : VirtualBase
+{
+	[[gnu::noinline]] int call(int x) override { return x + 1; }
+};
+
+// ns per call, with each call depending on the last so this is latency rather than throughput
+template <typename F>
+double call_latency_ns(F&& call)
+{
+	return benchmark_ns([&] {
+		int x = 0;
+		for (int i = 0; i < benchmark_calls; i++)
+			x = call(x);
+		do_not_optimize(x);
+	}) / benchmark_calls;
+}
+
+template <template <typename> class Function>
+void benchmark_function()
+{
+	printf("  sizeof: %zu bytes (std::function: %zu bytes)\n", sizeof(Function<int(int)>), sizeof(std::function<int(int)>));
+	record_benchmark("sizeof", double(sizeof(Function<int(int)>)), "bytes");
+
+	size_t allocating_capture = first_allocating_capture<Function, 8, 16, 24, 32, 40, 48, 56, 64, 96, 128, 192, 256>();
+	if (allocating_capture > 0)
+	{
+		printf("  heap allocation from capture size: %zu bytes\n", allocating_capture);
+		record_benchmark("heap allocation from capture size", double(allocating_capture), "bytes");
+	}
+	else
+		printf("  heap allocation from capture size: never, up to 256 bytes\n");
+
+	auto add_one = [](int x) { return x + 1; };
+
+	Function<int(int)> f{ add_one };
+	std::function<int(int)> std_f{ add_one };
+
+	VirtualDerived derived;
+	VirtualBase* base = &derived;
+	make_opaque(base);
+
+	double ns = call_latency_ns([&](int x) { return f(x); });
+	double std_ns = call_latency_ns([&](int x) { return std_f(x); });
+	double direct_ns = call_latency_ns([&](int x) { return direct_call(x); });
+	double virtual_ns = call_latency_ns([&](int x) { return base->call(x); });
+
+	printf("  call: %.2f ns (std::function: %.2f ns, direct call: %.2f ns, virtual call: %.2f ns)\n", ns, std_ns, direct_ns, virtual_ns);
+	record_benchmark("call", ns, "ns");
+}
+
+template <template <typename> class Function>
+void run()
+{
+	using Func = Function<int(int)>;
+
+	printf("\n%s\n-------------------------------\n", typeid(Func).name());
+
+	printf("Class methods:\n");
+
+	if constexpr (has_constructor_default<Func>)
+		output_result("constructor (default)", test_constructor_default<Function>);
+	else
+		output_warning("constructor (default)", "not implemented");
+
+	if constexpr (has_constructor_callable<Func>)
+	{
+		if constexpr (has_call<Func>)
+			output_result("constructor (callable), destructor", test_constructor_callable<Function>);
+		else
+			output_warning("constructor (callable), destructor", "can't test, missing requirements: operator()");
+	}
+	else
+		output_warning("constructor (callable), destructor", "not implemented");
+
+	if constexpr (has_call<Func>)
+	{
+		if constexpr (has_constructor_callable<Func>)
+			output_result("operator() (stateful)", test_call_state<Function>);
+		else
+			output_warning("operator() (stateful)", "can't test, missing requirements: constructor (callable)");
+	}
+	else
+		output_warning("operator() (stateful)", "not implemented");
+
+	constexpr bool can_test = has_constructor_callable<Func> && has_call<Func>;
+
+	if constexpr (std::copy_constructible<Func>)
+	{
+		if constexpr (can_test)
+			output_result("copy constructor", test_copy_constructor<Function>);
+		else
+			output_warning("copy constructor", "can't test, missing requirements: constructor (callable), operator()");
+	}
+	else
+		output_warning("copy constructor", "not implemented");
+
+	if constexpr (std::is_move_constructible_v<Func>)
+	{
+		if constexpr (can_test)
+			output_result("move constructor", test_move_constructor<Function>);
+		else
+			output_warning("move constructor", "can't test, missing requirements: constructor (callable), operator()");
+	}
+	else
+		output_warning("move constructor", "not implemented");
+
+	if constexpr (std::is_copy_assignable_v<Func>)
+	{
+		if constexpr (can_test)
+			output_result("copy assignment", test_copy_assignment<Function>);
+		else
+			output_warning("copy assignment", "can't test, missing requirements: constructor (callable), operator()");
+	}
+	else
+		output_warning("copy assignment", "not implemented");
+
+	if constexpr (std::is_move_assignable_v<Func>)
+	{
+		if constexpr (can_test)
+			output_result("move assignment", test_move_assignment<Function>);
+		else
+			output_warning("move assignment", "can't test, missing requirements: constructor (callable), operator()");
+	}
+	else
+		output_warning("move assignment", "not implemented");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (can_test)
+		run_benchmark("call overhead", benchmark_function<Function>);
+	else
+		output_warning("call overhead", "can't test, missing requirements: constructor (callable), operator()");
+
+	printf("\n");
+}
+
+}
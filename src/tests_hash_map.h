@@ -0,0 +1,490 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+
+namespace tests_hash_map
+{
+
+template <typename Map, typename K, typename V> concept has_insert = requires(Map m) { { m.insert(K{}, V{}) } -> std::same_as<bool>; };
+template <typename Map, typename K, typename V> concept has_find = requires(Map m, K k) { { m.find(k) } -> std::same_as<V*>; };
+template <typename Map, typename K> concept has_erase = requires(Map m, K k) { { m.erase(k) } -> std::same_as<bool>; };
+template <typename Map> concept has_rehash = requires(Map m) { m.rehash(size_t{}); };
+template <typename Map> concept has_size = requires(Map m) { { m.size() } -> std::same_as<size_t>; };
+template <typename Map> concept has_capacity = requires(Map m) { { m.capacity() } -> std::same_as<size_t>; };
+
+// Optional instrumentation: the number of slots inspected to find a key
+template <typename Map, typename K> concept has_probe_length = requires(Map m, K k) { { m.probe_length(k) } -> std::same_as<size_t>; };
+
+// Keys inserted for each benchmark configuration
+constexpr size_t benchmark_entries = 1 << 18;
+
+// Load factors the benchmark tables are sized for, by calling rehash before inserting
+constexpr double benchmark_load_factors[] = { 0.25, 0.5, 0.75, 0.9 };
+
+enum class KeyDistribution
+{
+	Sequential,
+	Random,
+	// Only the high bits vary, which defeats identity hashes masked down to a power of two
+	Strided
+};
+
+constexpr KeyDistribution benchmark_distributions[] = { KeyDistribution::Sequential, KeyDistribution::Random, KeyDistribution::Strided };
+
+const char* distribution_name(KeyDistribution distribution)
+{
+	switch (distribution)
+	{
+	case KeyDistribution::Sequential: return "sequential";
+	case KeyDistribution::Random: return "random";
+	case KeyDistribution::Strided: return "strided";
+	}
+	return "";
+}
+
+// Allocator for the std::unordered_map baseline that goes through counted_malloc, so bytes per entry can be compared
+template <typename T>
+struct CountedAllocator
+{
+	using value_type = T;
+
+	CountedAllocator() = default;
+	template <typename U> CountedAllocator(const CountedAllocator<U>&) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(malloc(n * sizeof(T))); }
+	void deallocate(T* p, size_t) { free(p); }
+
+	template <typename U> bool operator==(const CountedAllocator<U>&) const { return true; }
+};
+
+// std::unordered_map behind the same interface as the candidate, as the benchmark baseline
+template <typename K, typename V>
+struct StdHashMap
+{
+	StdHashMap() { map.max_load_factor(1.0f); }
+
+	bool insert(K key, V value) { return map.emplace(key, std::move(value)).second; }
+	V* find(const K& key) { auto it = map.find(key); return it == map.end() ? nullptr : &it->second; }
+	bool erase(const K& key) { return map.erase(key) != 0; }
+	void rehash(size_t count) { map.rehash(count); }
+	size_t size() { return map.size(); }
+	size_t capacity() { return map.bucket_count(); }
+
+	std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, CountedAllocator<std::pair<const K, V>>> map;
+};
+
+template <template <typename, typename> class HashMap>
+TestResult test_insert()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		HashMap<int, MemoryCorrectnessItem> m;
+
+		for (int i = 0; i < 100; i++)
+			if (!m.insert(i, MemoryCorrectnessItem{ i })) return TestResult::IncorrectResults;
+
+		if (m.size() != 100) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 100) return TestResult::IncorrectObjectHandling;
+
+		// Inserting an existing key leaves the original value in place
+		if (m.insert(50, MemoryCorrectnessItem{ -1 })) return TestResult::IncorrectResults;
+		if (m.size() != 100) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 100) return TestResult::IncorrectObjectHandling;
+		if constexpr (has_find<HashMap<int, MemoryCorrectnessItem>, int, MemoryCorrectnessItem>)
+		{
+			if (m.find(50) == nullptr || m.find(50)->id != 50) return TestResult::IncorrectResults;
+		}
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename, typename> class HashMap>
+TestResult test_find()
+{
+	HashMap<int, MemoryCorrectnessItem> m;
+
+	for (int i = 0; i < 1000; i++)
+		m.insert(i * 7, MemoryCorrectnessItem{ i });
+
+	m.insert(3500, MemoryCorrectnessItem{ -1 });
+
+	for (int i = 0; i < 1000; i++)
+	{
+		MemoryCorrectnessItem* value = m.find(i * 7);
+		if (value == nullptr || value->id != i) return TestResult::IncorrectResults;
+		if (value->status != MemoryCorrectnessItem::MemoryStatus::Constructed) return TestResult::IncorrectObjectHandling;
+	}
+
+	for (int i = 0; i < 1000; i++)
+		if (m.find(i * 7 + 1) != nullptr) return TestResult::IncorrectResults;
+
+	// Make sure we're returning the stored value, not a copy
+	m.find(0)->id = 69;
+	if (m.find(0)->id != 69) return TestResult::IncorrectResults;
+
+	return TestResult::Pass;
+}
+
+template <template <typename, typename> class HashMap>
+TestResult test_erase()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		HashMap<int, MemoryCorrectnessItem> m;
+
+		for (int i = 0; i < 1000; i++)
+			m.insert(i, MemoryCorrectnessItem{ i });
+
+		for (int i = 0; i < 1000; i += 2)
+			if (!m.erase(i)) return TestResult::IncorrectResults;
+
+		if (m.erase(0)) return TestResult::IncorrectResults;
+		if (m.erase(5000)) return TestResult::IncorrectResults;
+		if (m.size() != 500) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 500) return TestResult::IncorrectObjectHandling;
+
+		for (int i = 0; i < 1000; i++)
+		{
+			MemoryCorrectnessItem* value = m.find(i);
+			if ((i % 2 == 0) != (value == nullptr)) return TestResult::IncorrectResults;
+			if (value != nullptr && value->id != i) return TestResult::IncorrectResults;
+		}
+
+		// Churn through erase and reinsert, which is where tombstones or backward shifting go wrong
+		std::mt19937 rng(harness_options.seed);
+		for (int i = 0; i < 20000; i++)
+		{
+			int key = int(rng() % 2000);
+			if (m.find(key) != nullptr)
+			{
+				if (!m.erase(key)) return TestResult::IncorrectResults;
+			}
+			else
+			{
+				if (!m.insert(key, MemoryCorrectnessItem{ key })) return TestResult::IncorrectResults;
+			}
+		}
+
+		if (MemoryCorrectnessItem::count_alive() != m.size()) return TestResult::IncorrectObjectHandling;
+
+		for (int key = 0; key < 2000; key++)
+		{
+			MemoryCorrectnessItem* value = m.find(key);
+			if (value != nullptr && value->id != key) return TestResult::IncorrectResults;
+		}
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename, typename> class HashMap>
+TestResult test_rehash()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		HashMap<int, MemoryCorrectnessItem> m;
+
+		for (int i = 0; i < 1000; i++)
+			m.insert(i, MemoryCorrectnessItem{ i });
+
+		m.rehash(10000);
+
+		if (m.size() != 1000) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1000) return TestResult::IncorrectObjectHandling;
+
+		for (int i = 0; i < 1000; i++)
+		{
+			MemoryCorrectnessItem* value = m.find(i);
+			if (value == nullptr || value->id != i) return TestResult::IncorrectResults;
+		}
+
+		// Asking for fewer slots than there are entries must not lose any of them
+		m.rehash(0);
+
+		if (m.size() != 1000) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 1000; i++)
+		{
+			MemoryCorrectnessItem* value = m.find(i);
+			if (value == nullptr || value->id != i) return TestResult::IncorrectResults;
+		}
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename, typename> class HashMap>
+TestResult test_growth()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		HashMap<uint64_t, MemoryCorrectnessItem> m;
+		std::mt19937_64 rng(harness_options.seed);
+		std::vector<uint64_t> keys;
+
+		for (int i = 0; i < 100000; i++)
+		{
+			uint64_t key = rng();
+			keys.push_back(key);
+			m.insert(key, MemoryCorrectnessItem{ i });
+		}
+
+		if (m.size() != 100000) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 100000; i++)
+		{
+			MemoryCorrectnessItem* value = m.find(keys[i]);
+			if (value == nullptr || value->id != i) return TestResult::IncorrectResults;
+		}
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename, typename> class HashMap>
+TestResult test_destructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		HashMap<int, MemoryCorrectnessItem> m;
+		m.insert(1, MemoryCorrectnessItem{});
+		m.insert(2, MemoryCorrectnessItem{});
+	}
+
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+// Keys to insert, and the same number of keys from the same distribution that aren't inserted
+void generate_keys(KeyDistribution distribution, std::vector<uint64_t>& present, std::vector<uint64_t>& absent)
+{
+	std::mt19937_64 rng(harness_options.seed);
+
+	for (uint64_t i = 0; i < 2 * benchmark_entries; i++)
+	{
+		uint64_t key = 0;
+		switch (distribution)
+		{
+		case KeyDistribution::Sequential: key = i; break;
+		case KeyDistribution::Random: key = rng(); break;
+		case KeyDistribution::Strided: key = i << 32; break;
+		}
+
+		(i % 2 == 0 ? present : absent).push_back(key);
+	}
+
+	// Look keys up in a different order to insertion, so sequential keys don't walk memory in order
+	std::shuffle(present.begin(), present.end(), rng);
+	std::shuffle(absent.begin(), absent.end(), rng);
+}
+
+struct LookupResults
+{
+	double hits_per_second;
+	double misses_per_second;
+	double bytes_per_entry;
+	double load_factor;
+};
+
+template <typename Map>
+double lookups_per_second(Map& m, const std::vector<uint64_t>& keys)
+{
+	double ns = benchmark_ns([&] {
+		for (uint64_t key : keys)
+			do_not_optimize(m.find(key));
+	});
+
+	return keys.size() / ns * 1e9;
+}
+
+template <typename Map>
+LookupResults benchmark_lookups(Map& m, double load_factor, const std::vector<uint64_t>& present, const std::vector<uint64_t>& absent)
+{
+	LookupResults results;
+	size_t bytes_before = counted_malloc_bytes_live();
+
+	m.rehash(size_t(benchmark_entries / load_factor));
+	for (uint64_t key : present)
+		m.insert(key, key);
+
+	results.bytes_per_entry = double(counted_malloc_bytes_live() - bytes_before) / benchmark_entries;
+	results.hits_per_second = lookups_per_second(m, present);
+	results.misses_per_second = lookups_per_second(m, absent);
+
+	return results;
+}
+
+template <template <typename, typename> class HashMap>
+void benchmark_hash_lookups()
+{
+	for (KeyDistribution distribution : benchmark_distributions)
+	{
+		std::vector<uint64_t> present;
+		std::vector<uint64_t> absent;
+		generate_keys(distribution, present, absent);
+
+		for (double load_factor : benchmark_load_factors)
+		{
+			HashMap<uint64_t, uint64_t> m;
+			LookupResults results = benchmark_lookups(m, load_factor, present, absent);
+
+			StdHashMap<uint64_t, uint64_t> std_m;
+			LookupResults std_results = benchmark_lookups(std_m, load_factor, present, absent);
+
+			printf("  %s keys, load factor %.2f", distribution_name(distribution), load_factor);
+			if constexpr (has_capacity<HashMap<uint64_t, uint64_t>>)
+				printf(" (actual %.2f)", double(m.size()) / m.capacity());
+			printf(":\n");
+
+			printf("    hits: %.1f M lookups/s (std::unordered_map: %.1f M lookups/s, %.2fx)\n",
+				results.hits_per_second / 1e6, std_results.hits_per_second / 1e6, results.hits_per_second / std_results.hits_per_second);
+			printf("    misses: %.1f M lookups/s (std::unordered_map: %.1f M lookups/s, %.2fx)\n",
+				results.misses_per_second / 1e6, std_results.misses_per_second / 1e6, results.misses_per_second / std_results.misses_per_second);
+			printf("    bytes per entry: %.1f (std::unordered_map: %.1f)\n", results.bytes_per_entry, std_results.bytes_per_entry);
+
+			char name[128];
+			snprintf(name, sizeof(name), "hits (%s keys, load factor %.2f)", distribution_name(distribution), load_factor);
+			record_benchmark(name, results.hits_per_second / 1e6, "M lookups/s");
+			snprintf(name, sizeof(name), "misses (%s keys, load factor %.2f)", distribution_name(distribution), load_factor);
+			record_benchmark(name, results.misses_per_second / 1e6, "M lookups/s");
+			snprintf(name, sizeof(name), "bytes per entry (%s keys, load factor %.2f)", distribution_name(distribution), load_factor);
+			record_benchmark(name, results.bytes_per_entry, "bytes");
+
+			if constexpr (has_probe_length<HashMap<uint64_t, uint64_t>, uint64_t>)
+			{
+				size_t total = 0;
+				size_t longest = 0;
+				for (uint64_t key : present)
+				{
+					size_t length = m.probe_length(key);
+					total += length;
+					longest = std::max(longest, length);
+				}
+
+				printf("    probe length: %.2f average, %zu max\n", double(total) / present.size(), longest);
+				snprintf(name, sizeof(name), "probe length (%s keys, load factor %.2f, average)", distribution_name(distribution), load_factor);
+				record_benchmark(name, double(total) / present.size(), "probes");
+				snprintf(name, sizeof(name), "probe length (%s keys, load factor %.2f, max)", distribution_name(distribution), load_factor);
+				record_benchmark(name, double(longest), "probes");
+			}
+		}
+	}
+
+	if constexpr (!has_probe_length<HashMap<uint64_t, uint64_t>, uint64_t>)
+		output_warning("probe length", "not instrumented, implement probe_length(key)");
+}
+
+template <template <typename, typename> class HashMap>
+void run()
+{
+	using MapInt = HashMap<int, MemoryCorrectnessItem>;
+	using MapBenchmark = HashMap<uint64_t, uint64_t>;
+
+	printf("\n%s\n-------------------------------\n", typeid(MapInt).name());
+
+	printf("Class methods:\n");
+
+	if constexpr (has_insert<MapInt, int, MemoryCorrectnessItem>)
+	{
+		if constexpr (has_size<MapInt>)
+			output_result("insert", test_insert<HashMap>);
+		else
+			output_warning("insert", "can't test, missing requirements: size");
+	}
+	else
+		output_warning("insert", "not implemented");
+
+	if constexpr (has_find<MapInt, int, MemoryCorrectnessItem>)
+	{
+		if constexpr (has_insert<MapInt, int, MemoryCorrectnessItem>)
+			output_result("find", test_find<HashMap>);
+		else
+			output_warning("find", "can't test, missing requirements: insert");
+	}
+	else
+		output_warning("find", "not implemented");
+
+	constexpr bool has_insert_find_size = has_insert<MapInt, int, MemoryCorrectnessItem> && has_find<MapInt, int, MemoryCorrectnessItem> && has_size<MapInt>;
+
+	if constexpr (has_erase<MapInt, int>)
+	{
+		if constexpr (has_insert_find_size)
+			output_result("erase", test_erase<HashMap>);
+		else
+			output_warning("erase", "can't test, missing requirements: insert, find, size");
+	}
+	else
+		output_warning("erase", "not implemented");
+
+	if constexpr (has_rehash<MapInt>)
+	{
+		if constexpr (has_insert_find_size)
+			output_result("rehash", test_rehash<HashMap>);
+		else
+			output_warning("rehash", "can't test, missing requirements: insert, find, size");
+	}
+	else
+		output_warning("rehash", "not implemented");
+
+	if constexpr (has_insert_find_size)
+		output_result("growth", test_growth<HashMap>);
+	else
+		output_warning("growth", "can't test, missing requirements: insert, find, size");
+
+	if constexpr (has_insert<MapInt, int, MemoryCorrectnessItem>)
+		output_result("(destructor)", test_destructor<HashMap>);
+	else
+		output_warning("(destructor)", "can't test, missing requirements: insert");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (has_insert<MapBenchmark, uint64_t, uint64_t> && has_find<MapBenchmark, uint64_t, uint64_t> && has_rehash<MapBenchmark>)
+		run_benchmark("lookups", benchmark_hash_lookups<HashMap>);
+	else
+		output_warning("lookups", "can't test, missing requirements: insert, find, rehash");
+
+	printf("\n");
+}
+
+}
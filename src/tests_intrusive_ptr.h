@@ -0,0 +1,598 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <atomic>
+#include <vector>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+
+namespace tests_intrusive_ptr
+{
+
+// MemoryCorrectnessItem with the reference count inside the object. The pointer manages it through
+// intrusive_ptr_add_ref and intrusive_ptr_release, which it should find by argument dependent lookup.
+struct RefCountedItem : MemoryCorrectnessItem
+{
+	RefCountedItem(int id = 0) : MemoryCorrectnessItem(id) {}
+
+	friend void intrusive_ptr_add_ref(RefCountedItem* p)
+	{
+		p->ref_count += 1;
+	}
+
+	friend void intrusive_ptr_release(RefCountedItem* p)
+	{
+		if (--p->ref_count == 0)
+			delete p;
+	}
+
+	void foo() {}
+
+	std::atomic<long> ref_count = 0;
+};
+
+template <typename IP, typename T> concept has_constructor_ptr = requires(T * tp) { IP{ tp }; };
+template <typename IP, typename T> concept has_constructor_default = requires { IP{}; };
+template <typename IP, typename T> concept has_reset = requires(IP u, T * t) { u.reset(t); };
+template <typename IP, typename T> concept has_reset_empty = requires(IP u) { u.reset(); };
+template <typename IP, typename T> concept has_get = requires(IP u) { { u.get() } -> std::same_as<T*>; };
+template <typename IP, typename T> concept has_operator_star = requires(IP u) { { *u } -> std::same_as<T&>; };
+template <typename IP, typename T> concept has_operator_arrow = requires(IP u) { u->foo(); };
+
+template <template <typename> class IntrusivePtr>
+TestResult test_constructor_default()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	IntrusivePtr<RefCountedItem>{};
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_constructor_ptr()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		RefCountedItem* raw = new RefCountedItem();
+		IntrusivePtr<RefCountedItem> p(raw);
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+
+		if (raw->ref_count != 1)
+			return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_copy_constructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		RefCountedItem* raw = new RefCountedItem();
+		IntrusivePtr<RefCountedItem> p(raw);
+
+		{
+			IntrusivePtr<RefCountedItem> q(p);
+
+			if (raw->ref_count != 2)
+				return TestResult::IncorrectResults;
+
+			if (MemoryCorrectnessItem::count_alive() != 1)
+				return TestResult::IncorrectObjectHandling;
+		}
+
+		if (raw->ref_count != 1)
+			return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_move_constructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		RefCountedItem* raw = new RefCountedItem();
+		IntrusivePtr<RefCountedItem> p(raw);
+		IntrusivePtr<RefCountedItem> q(std::move(p));
+
+		// Moving transfers the reference rather than taking a new one
+		if (raw->ref_count != 1)
+			return TestResult::SuboptimalObjectHandling;
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_copy_assignment()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		IntrusivePtr<RefCountedItem> p(new RefCountedItem());
+		{
+			IntrusivePtr<RefCountedItem> q(new RefCountedItem());
+
+			p = q;
+
+			if (MemoryCorrectnessItem::count_alive() != 1)
+				return TestResult::IncorrectObjectHandling;
+		}
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+
+		// Self assignment must not drop the last reference
+		auto& self = p;
+		p = self;
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_move_assignment()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		IntrusivePtr<RefCountedItem> p(new RefCountedItem());
+		{
+			RefCountedItem* raw = new RefCountedItem();
+			IntrusivePtr<RefCountedItem> q(raw);
+
+			p = std::move(q);
+
+			if (MemoryCorrectnessItem::count_alive() != 1)
+				return TestResult::IncorrectObjectHandling;
+
+			if (raw->ref_count != 1)
+				return TestResult::SuboptimalObjectHandling;
+		}
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_reset()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		IntrusivePtr<RefCountedItem> p(new RefCountedItem());
+
+		p.reset();
+
+		if (MemoryCorrectnessItem::count_alive() != 0)
+			return TestResult::IncorrectObjectHandling;
+
+		p.reset(new RefCountedItem());
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+
+		p.reset(new RefCountedItem());
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_shared_from_raw()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		RefCountedItem* raw = new RefCountedItem();
+		IntrusivePtr<RefCountedItem> p(raw);
+
+		// The count lives in the object, so a second pointer made from the raw pointer joins the same count
+		IntrusivePtr<RefCountedItem> q(raw);
+
+		if (raw->ref_count != 2)
+			return TestResult::IncorrectResults;
+
+		p.reset();
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	// There is no control block, so the pointer itself should never allocate
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_get()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		RefCountedItem* raw = new RefCountedItem();
+		IntrusivePtr<RefCountedItem> p(raw);
+
+		if (p.get() != raw)
+			return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_operator_star()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		RefCountedItem* raw = new RefCountedItem();
+		IntrusivePtr<RefCountedItem> p(raw);
+
+		if (&(*p) != raw)
+			return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class IntrusivePtr>
+TestResult test_operator_arrow()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		RefCountedItem* raw = new RefCountedItem(42);
+		IntrusivePtr<RefCountedItem> p(raw);
+
+		if (p->id != 42)
+			return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	if (counted_malloc_allocations != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+// Allocations made by the pointer itself, per object, when creating count owners
+template <typename Ptr, typename T>
+double allocations_per_object(int count)
+{
+	std::vector<Ptr> owners;
+	owners.reserve(count);
+
+	counted_malloc_reset();
+
+	for (int i = 0; i < count; i++)
+		owners.emplace_back(new T());
+
+	return double(counted_malloc_allocations) / count;
+}
+
+// Time to copy a pointer and destroy the copy, count times
+template <typename Ptr, typename T>
+double copy_destroy_ns(int count)
+{
+	Ptr p(new T());
+
+	return benchmark_ns([&] {
+		for (int i = 0; i < count; i++)
+		{
+			Ptr copy(p);
+			do_not_optimize(copy);
+		}
+	}) / count;
+}
+
+template <template <typename> class IntrusivePtr, template <typename> class SharedPtr>
+void benchmark_against_shared_ptr()
+{
+	constexpr int count = 10000;
+
+	printf("  sizeof: %zu bytes", sizeof(IntrusivePtr<RefCountedItem>));
+	if constexpr (std::is_constructible_v<SharedPtr<MemoryCorrectnessItem>, MemoryCorrectnessItem*>)
+		printf(" (shared pointer: %zu bytes)", sizeof(SharedPtr<MemoryCorrectnessItem>));
+	printf("\n");
+	record_benchmark("sizeof", double(sizeof(IntrusivePtr<RefCountedItem>)), "bytes");
+
+	double intrusive_allocs = allocations_per_object<IntrusivePtr<RefCountedItem>, RefCountedItem>(count);
+	double intrusive_ns = copy_destroy_ns<IntrusivePtr<RefCountedItem>, RefCountedItem>(count);
+
+	if constexpr (std::is_constructible_v<SharedPtr<MemoryCorrectnessItem>, MemoryCorrectnessItem*> && std::is_copy_constructible_v<SharedPtr<MemoryCorrectnessItem>>)
+	{
+		double shared_allocs = allocations_per_object<SharedPtr<MemoryCorrectnessItem>, MemoryCorrectnessItem>(count);
+		double shared_ns = copy_destroy_ns<SharedPtr<MemoryCorrectnessItem>, MemoryCorrectnessItem>(count);
+
+		printf("  allocations per object: %.2f (shared pointer: %.2f)\n", intrusive_allocs, shared_allocs);
+		printf("  copy and destroy: %.2f ns/op (shared pointer: %.2f ns/op, %.2fx)\n", intrusive_ns, shared_ns, shared_ns / intrusive_ns);
+		record_benchmark("allocations per object", intrusive_allocs, "allocations");
+		record_benchmark("copy and destroy", intrusive_ns, "ns/op");
+	}
+	else
+	{
+		output_benchmark("allocations per object", intrusive_allocs, "allocations");
+		output_benchmark("copy and destroy", intrusive_ns, "ns/op");
+		output_warning("shared pointer comparison", "can't test, missing requirements: shared pointer constructor (pointer), copy constructor");
+	}
+}
+
+template <template <typename> class IntrusivePtr, template <typename> class SharedPtr>
+void run()
+{
+	using IP = IntrusivePtr<RefCountedItem>;
+
+	printf("\n%s\n-------------------------------\n", typeid(IntrusivePtr<RefCountedItem>).name());
+
+	printf("Class methods:\n");
+
+	if constexpr (has_constructor_default<IP, RefCountedItem>)
+		output_result("constructor (default)", test_constructor_default<IntrusivePtr>);
+	else
+		output_warning("constructor (default)", "not implemented");
+
+	if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+		output_result("constructor (pointer), destructor", test_constructor_ptr<IntrusivePtr>);
+	else
+		output_warning("constructor (pointer), destructor", "not implemented");
+
+	if constexpr (std::copy_constructible<IP>)
+	{
+		if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+			output_result("copy constructor", test_copy_constructor<IntrusivePtr>);
+		else
+			output_warning("copy constructor", "can't test, missing requirements: constructor (pointer)");
+	}
+	else
+		output_warning("copy constructor", "not implemented");
+
+	if constexpr (std::is_move_constructible_v<IP>)
+	{
+		if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+			output_result("move constructor", test_move_constructor<IntrusivePtr>);
+		else
+			output_warning("move constructor", "can't test, missing requirements: constructor (pointer)");
+	}
+	else
+		output_warning("move constructor", "not implemented");
+
+	if constexpr (std::is_copy_assignable_v<IP>)
+	{
+		if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+			output_result("copy assignment", test_copy_assignment<IntrusivePtr>);
+		else
+			output_warning("copy assignment", "can't test, missing requirements: constructor (pointer)");
+	}
+	else
+		output_warning("copy assignment", "not implemented");
+
+	if constexpr (std::is_move_assignable_v<IP>)
+	{
+		if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+			output_result("move assignment", test_move_assignment<IntrusivePtr>);
+		else
+			output_warning("move assignment", "can't test, missing requirements: constructor (pointer)");
+	}
+	else
+		output_warning("move assignment", "not implemented");
+
+	if constexpr (has_reset<IP, RefCountedItem> && has_reset_empty<IP, RefCountedItem>)
+	{
+		if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+			output_result("reset", test_reset<IntrusivePtr>);
+		else
+			output_warning("reset", "can't test, missing requirements: constructor (pointer)");
+	}
+	else
+		output_warning("reset", "not implemented");
+
+	if constexpr (has_constructor_ptr<IP, RefCountedItem> && has_reset_empty<IP, RefCountedItem>)
+		output_result("shared ownership from raw pointer", test_shared_from_raw<IntrusivePtr>);
+	else
+		output_warning("shared ownership from raw pointer", "can't test, missing requirements: constructor (pointer), reset");
+
+	if constexpr (has_get<IP, RefCountedItem>)
+	{
+		if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+			output_result("get", test_get<IntrusivePtr>);
+		else
+			output_warning("get", "can't test, missing requirements: constructor (pointer)");
+	}
+	else
+		output_warning("get", "not implemented");
+
+	if constexpr (has_operator_star<IP, RefCountedItem>)
+	{
+		if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+			output_result("operator*", test_operator_star<IntrusivePtr>);
+		else
+			output_warning("operator*", "can't test, missing requirements: constructor (pointer)");
+	}
+	else
+		output_warning("operator*", "not implemented");
+
+	if constexpr (has_operator_arrow<IP, RefCountedItem>)
+	{
+		if constexpr (has_constructor_ptr<IP, RefCountedItem>)
+			output_result("operator->", test_operator_arrow<IntrusivePtr>);
+		else
+			output_warning("operator->", "can't test, missing requirements: constructor (pointer)");
+	}
+	else
+		output_warning("operator->", "not implemented");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (has_constructor_ptr<IP, RefCountedItem> && std::copy_constructible<IP>)
+		run_benchmark("against shared pointer", benchmark_against_shared_ptr<IntrusivePtr, SharedPtr>);
+	else
+		output_warning("against shared pointer", "can't test, missing requirements: constructor (pointer), copy constructor");
+
+	printf("\n");
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <algorithm>
+
+#include "memory_correctness_item.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+#include "concurrency_common.h"
+#include "queue_common.h"
+
+namespace tests_mpmc_queue
+{
+
+template <typename Q> concept has_constructor_capacity = requires { Q(size_t{ 16 }); };
+template <typename Q, typename T> concept has_try_push = requires(Q q, T t) { { q.try_push(std::move(t)) } -> std::same_as<bool>; };
+template <typename Q, typename T> concept has_try_pop = requires(Q q, T& t) { { q.try_pop(t) } -> std::same_as<bool>; };
+
+// Producers and consumers each in the contention tests, at least this many even with fewer cores
+constexpr int contention_min_threads = 4;
+
+template <template <typename> class Queue>
+void benchmark_throughput_scaling()
+{
+	// One thread pushes and pops by itself, more are split between producers and consumers
+	for (int thread_count : scaling_thread_counts())
+	{
+		if (thread_count == 1)
+			benchmark_throughput<Queue>(1, 0);
+		else
+			benchmark_throughput<Queue>(thread_count / 2, thread_count - thread_count / 2);
+	}
+}
+
+template <template <typename> class Queue>
+void run()
+{
+	using QueueItem = Queue<MemoryCorrectnessItem>;
+
+	printf("\n%s\n-------------------------------\n", typeid(Queue<int>).name());
+
+	printf("Class methods:\n");
+
+	constexpr bool can_test = has_constructor_capacity<QueueItem> && has_try_push<QueueItem, MemoryCorrectnessItem> &&
+		has_try_pop<QueueItem, MemoryCorrectnessItem>;
+
+	if constexpr (!has_constructor_capacity<QueueItem>)
+		output_warning("constructor (capacity)", "not implemented");
+
+	if constexpr (has_try_push<QueueItem, MemoryCorrectnessItem> && has_try_pop<QueueItem, MemoryCorrectnessItem>)
+	{
+		if constexpr (can_test)
+			output_result("try_push/try_pop", test_try_push_pop<Queue>);
+		else
+			output_warning("try_push/try_pop", "can't test, missing requirements: constructor (capacity)");
+	}
+	else
+		output_warning("try_push/try_pop", "not implemented");
+
+	// The name stays the same on every machine, so results can be compared, and the thread count is printed instead
+	int contention_threads = std::max(max_thread_count() / 2, contention_min_threads);
+
+	if constexpr (can_test)
+	{
+		output_result("destructor", test_destructor<Queue>);
+		if (test_selected("exactly once"))
+			printf("  exactly once runs with %d producers and %d consumers\n", contention_threads, contention_threads);
+		output_result("exactly once", [&] { return test_exactly_once<Queue>(contention_threads, contention_threads); });
+		output_result("linearizable (1 producer, 1 consumer, 2 doing both)", [] { return test_linearizable<Queue>(1, 1, 2); });
+	}
+	else
+	{
+		output_warning("destructor", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+		output_warning("exactly once", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+		output_warning("linearizable (1 producer, 1 consumer, 2 doing both)", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+	}
+
+	printf("Benchmarks:\n");
+
+	if constexpr (can_test)
+	{
+		run_benchmark("throughput", benchmark_throughput_scaling<Queue>);
+		run_benchmark("latency", [] { benchmark_latency<Queue>(std::max(max_thread_count() / 2, 1)); });
+		run_benchmark("false sharing", benchmark_false_sharing<Queue>);
+	}
+	else
+	{
+		output_warning("throughput", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+		output_warning("latency", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+		output_warning("false sharing", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+	}
+
+	printf("\n");
+}
+
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+
+namespace tests_optional
+{
+
+template <typename Opt> concept has_constructor_default = requires { Opt{}; };
+template <typename Opt, typename T> concept has_constructor_value = requires { Opt{ T{} }; };
+template <typename Opt> concept has_has_value = requires(Opt o) { { o.has_value() } -> std::same_as<bool>; };
+template <typename Opt, typename T> concept has_operator_star = requires(Opt o) { { *o } -> std::same_as<T&>; };
+template <typename Opt> concept has_reset = requires(Opt o) { o.reset(); };
+template <typename Opt, typename T> concept has_emplace = requires(Opt o) { { o.emplace(0) } -> std::same_as<T&>; };
+template <typename Opt, typename T> concept has_assign_value = requires(Opt o) { o = T{}; };
+
+template <template <typename> class Optional>
+TestResult test_constructor_default()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Optional<MemoryCorrectnessItem> o{};
+
+		if (o.has_value()) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_destroyed != 0) return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Optional>
+TestResult test_constructor_value()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Optional<MemoryCorrectnessItem> o{ MemoryCorrectnessItem{ 42 } };
+
+		if (!o.has_value() || (*o).id != 42) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != 0) return TestResult::SuboptimalObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Optional>
+TestResult test_reset()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Optional<MemoryCorrectnessItem> o{ MemoryCorrectnessItem{ 42 } };
+
+		o.reset();
+
+		if (o.has_value()) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+		// Resetting an empty optional, and destroying it afterwards, mustn't destroy anything again
+		o.reset();
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Optional>
+TestResult test_emplace()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Optional<MemoryCorrectnessItem> o{};
+
+		MemoryCorrectnessItem& item = o.emplace(1);
+
+		if (!o.has_value() || (*o).id != 1 || &item != &*o) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		// Emplacing over an engaged optional destroys the old value first
+		o.emplace(2);
+
+		if ((*o).id != 2) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+		if (MemoryCorrectnessItem::count_destroyed != 1) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0 || MemoryCorrectnessItem::count_constructed_move != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Optional>
+TestResult test_assign_value()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Optional<MemoryCorrectnessItem> o{};
+
+		// Engages by construction
+		o = MemoryCorrectnessItem{ 1 };
+
+		if (!o.has_value() || (*o).id != 1) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		// Already engaged, so assigns to the value in place
+		o = MemoryCorrectnessItem{ 2 };
+
+		if ((*o).id != 2) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+		if (MemoryCorrectnessItem::count_assigned_move != 1) return TestResult::SuboptimalObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0 || MemoryCorrectnessItem::count_assigned_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Optional>
+TestResult test_copy()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Optional<MemoryCorrectnessItem> engaged{ MemoryCorrectnessItem{ 1 } };
+		Optional<MemoryCorrectnessItem> empty{};
+
+		Optional<MemoryCorrectnessItem> engaged_copy{ engaged };
+		Optional<MemoryCorrectnessItem> empty_copy{ empty };
+
+		if (!engaged_copy.has_value() || (*engaged_copy).id != 1 || empty_copy.has_value()) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 2) return TestResult::IncorrectObjectHandling;
+
+		// Every combination of engaged and empty on either side
+		Optional<MemoryCorrectnessItem> target{ MemoryCorrectnessItem{ 2 } };
+		target = engaged;
+		if (!target.has_value() || (*target).id != 1) return TestResult::IncorrectResults;
+
+		target = empty;
+		if (target.has_value()) return TestResult::IncorrectResults;
+
+		target = empty;
+		if (target.has_value()) return TestResult::IncorrectResults;
+
+		target = engaged;
+		if (!target.has_value() || (*target).id != 1) return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 3) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Optional>
+TestResult test_move()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Optional<MemoryCorrectnessItem> engaged{ MemoryCorrectnessItem{ 1 } };
+		Optional<MemoryCorrectnessItem> moved{ std::move(engaged) };
+
+		if (!moved.has_value() || (*moved).id != 1) return TestResult::IncorrectResults;
+
+		Optional<MemoryCorrectnessItem> target{};
+		target = std::move(moved);
+		if (!target.has_value() || (*target).id != 1) return TestResult::IncorrectResults;
+
+		Optional<MemoryCorrectnessItem> empty{};
+		target = std::move(empty);
+		if (target.has_value()) return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0 || MemoryCorrectnessItem::count_assigned_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Optional, typename T>
+void output_sizeof(const char* payload_name)
+{
+	printf("  sizeof (%s): %zu bytes, %zu over payload (std::optional: %zu bytes)\n",
+		payload_name, sizeof(Optional<T>), sizeof(Optional<T>) - sizeof(T), sizeof(std::optional<T>));
+
+	char name[128];
+	snprintf(name, sizeof(name), "sizeof (%s)", payload_name);
+	record_benchmark(name, double(sizeof(Optional<T>)), "bytes");
+}
+
+template <template <typename> class Optional>
+void run()
+{
+	using Opt = Optional<MemoryCorrectnessItem>;
+
+	printf("\n%s\n-------------------------------\n", typeid(Opt).name());
+
+	printf("Class methods:\n");
+
+	constexpr bool can_check = has_has_value<Opt> && has_operator_star<Opt, MemoryCorrectnessItem>;
+
+	if constexpr (has_constructor_default<Opt>)
+	{
+		if constexpr (has_has_value<Opt>)
+			output_result("constructor (default)", test_constructor_default<Optional>);
+		else
+			output_warning("constructor (default)", "can't test, missing requirements: has_value");
+	}
+	else
+		output_warning("constructor (default)", "not implemented");
+
+	if constexpr (has_constructor_value<Opt, MemoryCorrectnessItem>)
+	{
+		if constexpr (can_check)
+			output_result("constructor (value), destructor", test_constructor_value<Optional>);
+		else
+			output_warning("constructor (value), destructor", "can't test, missing requirements: has_value, operator*");
+	}
+	else
+		output_warning("constructor (value), destructor", "not implemented");
+
+	if constexpr (has_reset<Opt>)
+	{
+		if constexpr (has_constructor_value<Opt, MemoryCorrectnessItem> && has_has_value<Opt>)
+			output_result("reset", test_reset<Optional>);
+		else
+			output_warning("reset", "can't test, missing requirements: constructor (value), has_value");
+	}
+	else
+		output_warning("reset", "not implemented");
+
+	if constexpr (has_emplace<Opt, MemoryCorrectnessItem>)
+	{
+		if constexpr (has_constructor_default<Opt> && can_check)
+			output_result("emplace", test_emplace<Optional>);
+		else
+			output_warning("emplace", "can't test, missing requirements: constructor (default), has_value, operator*");
+	}
+	else
+		output_warning("emplace", "not implemented");
+
+	if constexpr (has_assign_value<Opt, MemoryCorrectnessItem>)
+	{
+		if constexpr (has_constructor_default<Opt> && can_check)
+			output_result("assignment (value)", test_assign_value<Optional>);
+		else
+			output_warning("assignment (value)", "can't test, missing requirements: constructor (default), has_value, operator*");
+	}
+	else
+		output_warning("assignment (value)", "not implemented");
+
+	constexpr bool can_construct = has_constructor_default<Opt> && has_constructor_value<Opt, MemoryCorrectnessItem>;
+
+	if constexpr (std::copy_constructible<Opt> && std::is_copy_assignable_v<Opt>)
+	{
+		if constexpr (can_construct && can_check)
+			output_result("copy constructor/assignment", test_copy<Optional>);
+		else
+			output_warning("copy constructor/assignment", "can't test, missing requirements: constructor (default), constructor (value), has_value, operator*");
+	}
+	else
+		output_warning("copy constructor/assignment", "not implemented");
+
+	if constexpr (std::is_move_constructible_v<Opt> && std::is_move_assignable_v<Opt>)
+	{
+		if constexpr (can_construct && can_check)
+			output_result("move constructor/assignment", test_move<Optional>);
+		else
+			output_warning("move constructor/assignment", "can't test, missing requirements: constructor (default), constructor (value), has_value, operator*");
+	}
+	else
+		output_warning("move constructor/assignment", "not implemented");
+
+	// Lets optionals of trivial types live in buffers that are memcpy'd around and never destroyed
+	if constexpr (has_constructor_value<Optional<int>, int>)
+	{
+		if (std::is_trivially_destructible_v<Optional<int>>)
+			output_result("trivially destructible (trivial payload)", TestResult::Pass);
+		else
+			output_result("trivially destructible (trivial payload)", TestResult::IncorrectObjectHandling);
+	}
+	else
+		output_warning("trivially destructible (trivial payload)", "can't test, missing requirements: constructor (value)");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (has_constructor_value<Opt, MemoryCorrectnessItem>)
+	{
+		run_benchmark("sizeof", [] {
+			output_sizeof<Optional, char>("char");
+			output_sizeof<Optional, int>("int");
+			output_sizeof<Optional, double>("double");
+			output_sizeof<Optional, MemoryCorrectnessItem>("MemoryCorrectnessItem");
+		});
+	}
+	else
+		output_warning("sizeof", "can't test, missing requirements: constructor (value)");
+
+	printf("\n");
+}
+
+}
@@ -8,6 +8,7 @@
 #include "memory_correctness_item.h"
 #include "counted_malloc.h"
 #include "tests_common.h"
+#include "benchmark_common.h"
 
 namespace tests_shared_ptr
 {
@@ -27,6 +28,39 @@ struct Fooable
 template <template <typename> class UP> concept has_operator_arrow = requires(UP<Fooable> u) { u->foo(); };
 
 template <typename UP, typename T> concept has_use_count = requires(UP u) { { u.use_count() } -> std::same_as<long>; };
+template <template <typename> class SP> concept has_aliasing_constructor = requires(SP<Fooable> owner, int* p) { SP<int>(owner, p); };
+
+// Stand-in for candidates that don't provide an enable_shared_from_this base
+template <typename T>
+struct NoEnableSharedFromThis
+{
+};
+
+template <template <typename> class EnableSharedFromThis>
+struct SharedFromThisItem : EnableSharedFromThis<SharedFromThisItem<EnableSharedFromThis>>, MemoryCorrectnessItem
+{
+};
+
+template <template <typename> class SP, template <typename> class ESFT> concept has_shared_from_this = requires(SP<SharedFromThisItem<ESFT>> p) {
+	{ p.get()->shared_from_this() } -> std::same_as<SP<SharedFromThisItem<ESFT>>>;
+};
+
+// Object with a member that aliasing pointers can point into
+struct AliasOwner
+{
+	MemoryCorrectnessItem member;
+	int value = 42;
+};
+
+// Payload for fresh owners in the aliasing benchmark, allocated through counted_malloc so its allocation is counted
+// along with the control block's
+struct CountedInt
+{
+	int value;
+
+	static void* operator new(size_t size) { return malloc(size); }
+	static void operator delete(void* ptr) { free(ptr); }
+};
 
 template <template <typename> class SharedPtr>
 TestResult test_constructor_default()
@@ -404,30 +438,176 @@ TestResult test_use_count()
 }
 
 template <template <typename> class SharedPtr>
+TestResult test_aliasing_constructor()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		SharedPtr<AliasOwner> owner(new AliasOwner());
+		size_t allocs_before = counted_malloc_allocations;
+
+		SharedPtr<MemoryCorrectnessItem> alias(owner, &owner.get()->member);
+
+		if (alias.get() != &owner.get()->member)
+			return TestResult::IncorrectResults;
+
+		if (owner.use_count() != 2 || alias.use_count() != 2)
+			return TestResult::IncorrectResults;
+
+		SharedPtr<int> value_alias(alias, &owner.get()->value);
+		SharedPtr<MemoryCorrectnessItem> alias_copy(alias);
+
+		if (*value_alias != 42)
+			return TestResult::IncorrectResults;
+
+		if (owner.use_count() != 4)
+			return TestResult::IncorrectResults;
+
+		// Aliases share the owner's control block, so none of them should have allocated
+		if (counted_malloc_allocations != allocs_before)
+			return TestResult::SuboptimalObjectHandling;
+
+		// The aliases alone have to keep the owner alive
+		owner.reset();
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+
+		if (alias.use_count() != 3)
+			return TestResult::IncorrectResults;
+
+		alias.reset();
+		value_alias.reset();
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class SharedPtr, template <typename> class EnableSharedFromThis>
+TestResult test_shared_from_this()
+{
+	using Item = SharedFromThisItem<EnableSharedFromThis>;
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		SharedPtr<Item> p(new Item());
+		size_t allocs_before = counted_malloc_allocations;
+
+		SharedPtr<Item> q = p.get()->shared_from_this();
+
+		if (q.get() != p.get())
+			return TestResult::IncorrectResults;
+
+		// A second control block would show up as a use count of 1, and a double delete later on
+		if (p.use_count() != 2 || q.use_count() != 2)
+			return TestResult::IncorrectObjectHandling;
+
+		if (counted_malloc_allocations != allocs_before)
+			return TestResult::SuboptimalObjectHandling;
+
+		p.reset();
+
+		if (MemoryCorrectnessItem::count_alive() != 1)
+			return TestResult::IncorrectObjectHandling;
+
+		SharedPtr<Item> r = q.get()->shared_from_this();
+
+		if (r.use_count() != 2)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_allocations != counted_malloc_deallocations)
+		return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class SharedPtr>
+void benchmark_aliasing()
+{
+	constexpr int count = 1000;
+
+	SharedPtr<AliasOwner> owner(new AliasOwner());
+
+	auto make_aliases = [&] {
+		for (int i = 0; i < count; i++)
+		{
+			SharedPtr<int> alias(owner, &owner.get()->value);
+			do_not_optimize(alias);
+		}
+	};
+
+	auto make_fresh_owners = [&] {
+		for (int i = 0; i < count; i++)
+		{
+			SharedPtr<CountedInt> fresh(new CountedInt{ 42 });
+			do_not_optimize(fresh);
+		}
+	};
+
+	// Allocations are counted over one untimed pass, so they don't depend on how many runs benchmark_ns makes
+	counted_malloc_reset();
+	make_aliases();
+	double alias_allocs = double(counted_malloc_allocations) / count;
+
+	counted_malloc_reset();
+	make_fresh_owners();
+	double fresh_allocs = double(counted_malloc_allocations) / count;
+
+	double alias_ns = benchmark_ns(make_aliases);
+	double fresh_ns = benchmark_ns(make_fresh_owners);
+
+	output_benchmark_comparison("aliasing constructor (1000 pointers)", alias_ns, "fresh owners", fresh_ns);
+	printf("  aliasing constructor (allocations per pointer): %.2f (fresh owners: %.2f)\n", alias_allocs, fresh_allocs);
+	record_benchmark("aliasing constructor (allocations per pointer)", alias_allocs, "allocations");
+}
+
+template <template <typename> class SharedPtr, template <typename> class EnableSharedFromThis = NoEnableSharedFromThis>
 void run()
 {
-	printf("\n%s\n-------------------------------\n", typeid(SharedPtr).name());
+	printf("\n%s\n-------------------------------\n", typeid(SharedPtr<int>).name());
 
 	printf("Class methods:\n");
 
 	if constexpr (has_constructor_default<SharedPtr<int>, int>)
-		output_result("constructor (default)", test_constructor_default<SharedPtr>());
+		output_result("constructor (default)", test_constructor_default<SharedPtr>);
 	else
 		output_warning("constructor (default)", "not implemented");
 
 	if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-		output_result("constructor (pointer)", test_constructor_ptr<SharedPtr>());
+		output_result("constructor (pointer)", test_constructor_ptr<SharedPtr>);
 	else
 		output_warning("constructor (pointer)", "not implemented");
 
 	if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-		output_result("destructor", test_destructor<SharedPtr>());
+		output_result("destructor", test_destructor<SharedPtr>);
 	else
 		output_warning("destructor", "can't test, missing requirements: constructor (pointer)");
 
 	if constexpr (std::copy_constructible<SharedPtr<int>>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("copy constructor", test_copy_constructor<SharedPtr>());
+			output_result("copy constructor", test_copy_constructor<SharedPtr>);
 		else
 			output_warning("copy constructor", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -435,7 +615,7 @@ void run()
 
 	if constexpr (std::assignable_from<SharedPtr<int>&, SharedPtr<int>&> || std::assignable_from<SharedPtr<int>&, const SharedPtr<int>&> || std::assignable_from<SharedPtr<int>&, const SharedPtr<int>>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("copy assignment", test_copy_assignment<SharedPtr>());
+			output_result("copy assignment", test_copy_assignment<SharedPtr>);
 		else
 			output_warning("copy assignment", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -443,7 +623,7 @@ void run()
 
 	if constexpr (std::is_move_constructible_v<SharedPtr<int>>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("move constructor", test_move_constructor<SharedPtr>());
+			output_result("move constructor", test_move_constructor<SharedPtr>);
 		else
 			output_warning("move constructor", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -451,7 +631,7 @@ void run()
 
 	if constexpr (std::is_move_assignable_v<SharedPtr<int>>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("move assignment", test_move_assignment<SharedPtr>());
+			output_result("move assignment", test_move_assignment<SharedPtr>);
 		else
 			output_warning("move assignment", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -459,7 +639,7 @@ void run()
 
 	if constexpr (has_reset<SharedPtr<int>, int> && has_reset_empty<SharedPtr<int>, int>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("reset", test_reset<SharedPtr>());
+			output_result("reset", test_reset<SharedPtr>);
 		else
 			output_warning("reset", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -472,7 +652,7 @@ void run()
 
 	if constexpr (has_get<SharedPtr<int>, int>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("get", test_get<SharedPtr>());
+			output_result("get", test_get<SharedPtr>);
 		else
 			output_warning("get", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -480,7 +660,7 @@ void run()
 
 	if constexpr (has_operator_star<SharedPtr<int>, int>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("operator*", test_operator_star<SharedPtr>());
+			output_result("operator*", test_operator_star<SharedPtr>);
 		else
 			output_warning("operator*", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -488,7 +668,7 @@ void run()
 
 	if constexpr (has_operator_arrow<SharedPtr>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("operator->", test_operator_arrow<SharedPtr>());
+			output_result("operator->", test_operator_arrow<SharedPtr>);
 		else
 			output_warning("operator->", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -496,12 +676,39 @@ void run()
 
 	if constexpr (has_use_count<SharedPtr<int>, int>)
 		if constexpr (has_constructor_ptr<SharedPtr<int>, int>)
-			output_result("use_count", test_use_count<SharedPtr>());
+			output_result("use_count", test_use_count<SharedPtr>);
 		else
 			output_warning("use_count", "can't test, missing requirements: constructor (pointer)");
 	else
 		output_warning("use_count", "not implemented");
 
+	if constexpr (has_aliasing_constructor<SharedPtr>)
+	{
+		if constexpr (has_constructor_ptr<SharedPtr<int>, int> && has_get<SharedPtr<int>, int> && has_use_count<SharedPtr<int>, int> && has_reset_empty<SharedPtr<int>, int>)
+			output_result("aliasing constructor", test_aliasing_constructor<SharedPtr>);
+		else
+			output_warning("aliasing constructor", "can't test, missing requirements: constructor (pointer), get, use_count, reset");
+	}
+	else
+		output_warning("aliasing constructor", "not implemented");
+
+	if constexpr (has_shared_from_this<SharedPtr, EnableSharedFromThis>)
+	{
+		if constexpr (has_constructor_ptr<SharedPtr<int>, int> && has_get<SharedPtr<int>, int> && has_use_count<SharedPtr<int>, int> && has_reset_empty<SharedPtr<int>, int>)
+			output_result("enable_shared_from_this", test_shared_from_this<SharedPtr, EnableSharedFromThis>);
+		else
+			output_warning("enable_shared_from_this", "can't test, missing requirements: constructor (pointer), get, use_count, reset");
+	}
+	else
+		output_warning("enable_shared_from_this", "not implemented");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (has_aliasing_constructor<SharedPtr> && has_constructor_ptr<SharedPtr<int>, int> && has_get<SharedPtr<int>, int>)
+		run_benchmark("aliasing constructor (benchmark)", benchmark_aliasing<SharedPtr>);
+	else
+		output_warning("aliasing constructor (benchmark)", "can't test, missing requirements: aliasing constructor, constructor (pointer), get");
+
 	printf("\n");
 }
 
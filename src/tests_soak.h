@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <random>
+#include <chrono>
+#include <new>
+#include <utility>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+
+namespace tests_soak
+{
+
+template <typename Vec, typename T> concept has_push_back = requires(Vec v) { v.push_back(T{}); };
+template <typename Vec> concept has_size = requires(Vec v) { { v.size() } -> std::same_as<size_t>; };
+template <typename Vec> concept has_resize = requires(Vec v) { v.resize(42); };
+template <typename Vec> concept has_shrink_to_fit = requires(Vec v) { v.shrink_to_fit(); };
+template <typename SP, typename T> concept has_constructor_ptr = requires(T * tp) { SP{ tp }; };
+
+// Containers alive at once, each slot being created, grown, shrunk or destroyed at random
+constexpr int soak_vector_slots = 2000;
+constexpr int soak_pointer_slots = 4000;
+
+// Elements a vector can be grown to, and the most pushed by a single grow
+constexpr size_t soak_max_elements = 2048;
+constexpr size_t soak_max_grow = 256;
+
+// Samples taken over the run
+constexpr int soak_samples = 10;
+
+// The run stops early once RSS has grown by this much, which a bump arena that never empties reaches quickly
+constexpr size_t soak_max_rss_growth = size_t(2) << 30;
+
+// Shared pointer payload allocated through counted_malloc, so it's counted in the live bytes along with everything
+// else the soak holds in RSS
+struct SoakItem : MemoryCorrectnessItem
+{
+	using MemoryCorrectnessItem::MemoryCorrectnessItem;
+
+	static void* operator new(size_t size) { return malloc(size); }
+	static void operator delete(void* ptr) { free(ptr); }
+};
+
+// The containers' own objects, in counted memory for the same reason
+template <typename T>
+T* counted_new()
+{
+	return new (malloc(sizeof(T))) T();
+}
+
+template <typename T, typename Arg>
+T* counted_new(Arg&& arg)
+{
+	return new (malloc(sizeof(T))) T(std::forward<Arg>(arg));
+}
+
+template <typename T>
+void counted_delete(T* ptr)
+{
+	if (ptr == nullptr)
+		return;
+
+	ptr->~T();
+	free(ptr);
+}
+
+struct SoakSample
+{
+	double seconds;
+	size_t live_bytes;
+	size_t rss_bytes;
+	HeapStats heap;
+};
+
+// RSS grown since the start over the bytes asked of counted_malloc, 1 meaning every page is holding live data.
+// Memory an earlier run in the same process kept hold of gets reused, so for absolute numbers run each allocator
+// in a process of its own.
+double fragmentation_ratio(const SoakSample& sample, size_t rss_start)
+{
+	if (sample.live_bytes == 0)
+		return 0;
+	return double(sample.rss_bytes > rss_start ? sample.rss_bytes - rss_start : 0) / double(sample.live_bytes);
+}
+
+void output_sample(const SoakSample& sample, size_t rss_start)
+{
+	printf("  %5.1f s: live %.1f MB, RSS +%.1f MB (%.2fx)", sample.seconds, sample.live_bytes / 1e6,
+		(sample.rss_bytes > rss_start ? sample.rss_bytes - rss_start : 0) / 1e6, fragmentation_ratio(sample, rss_start));
+
+	if (sample.heap.available)
+		printf(", heap in use %.1f MB, heap free %.1f MB (%.0f%% free)", sample.heap.in_use / 1e6, sample.heap.free / 1e6,
+			100.0 * sample.heap.free / double(sample.heap.in_use + sample.heap.free));
+	printf("\n");
+}
+
+template <template <typename> class Vec, template <typename> class SharedPtr>
+TestResult soak(double seconds)
+{
+	using Clock = std::chrono::steady_clock;
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	Vec<MemoryCorrectnessItem>* vectors[soak_vector_slots] = {};
+	SharedPtr<SoakItem>* pointers[soak_pointer_slots] = {};
+
+	std::mt19937 rng(harness_options.seed);
+	size_t rss_start = read_rss_bytes();
+	double peak_ratio = 0;
+
+	auto start = Clock::now();
+	int samples_taken = 0;
+	int next_id = 0;
+
+	while (samples_taken < soak_samples)
+	{
+		for (int op = 0; op < 1024; op++)
+		{
+			int slot = int(rng() % soak_vector_slots);
+			auto& v = vectors[slot];
+
+			if (v == nullptr)
+				v = counted_new<Vec<MemoryCorrectnessItem>>();
+			else if (uint32_t choice = rng() % 8; choice < 4)
+			{
+				size_t count = std::min<size_t>(1 + rng() % soak_max_grow, soak_max_elements - v->size());
+				for (size_t i = 0; i < count; i++)
+					v->push_back(MemoryCorrectnessItem{ next_id++ });
+			}
+			else if (choice < 7)
+			{
+				v->resize(v->size() / 2);
+				if constexpr (has_shrink_to_fit<Vec<MemoryCorrectnessItem>>)
+				{
+					if (choice == 6)
+						v->shrink_to_fit();
+				}
+			}
+			else
+			{
+				counted_delete(v);
+				v = nullptr;
+			}
+
+			slot = int(rng() % soak_pointer_slots);
+			auto& p = pointers[slot];
+
+			if (p != nullptr)
+			{
+				counted_delete(p);
+				p = nullptr;
+			}
+			else if (auto& other = pointers[rng() % soak_pointer_slots]; other != nullptr && rng() % 2 == 0)
+				p = counted_new<SharedPtr<SoakItem>>(*other);
+			else
+				p = counted_new<SharedPtr<SoakItem>>(new SoakItem(next_id++));
+		}
+
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		if (elapsed < seconds * (samples_taken + 1) / soak_samples)
+			continue;
+
+		SoakSample sample = { elapsed, counted_malloc_bytes_live(), read_rss_bytes(), read_heap_stats() };
+		output_sample(sample, rss_start);
+		peak_ratio = std::max(peak_ratio, fragmentation_ratio(sample, rss_start));
+		samples_taken += 1;
+
+		if (sample.rss_bytes > rss_start + soak_max_rss_growth)
+		{
+			output_warning("soak", "stopped early, RSS grew by over 2 GB");
+			break;
+		}
+	}
+
+	for (auto& v : vectors)
+		counted_delete(v);
+	for (auto& p : pointers)
+		counted_delete(p);
+
+	size_t rss_end = read_rss_bytes();
+	printf("  after teardown: RSS +%.1f MB retained, peak fragmentation %.2fx\n", (rss_end > rss_start ? rss_end - rss_start : 0) / 1e6, peak_ratio);
+	record_benchmark("peak fragmentation (RSS growth / live bytes)", peak_ratio, "x");
+	record_benchmark("RSS retained after teardown", (rss_end > rss_start ? rss_end - rss_start : 0) / 1e6, "MB");
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (counted_malloc_bytes_live() != 0)
+		return TestResult::LeaksMemory;
+
+	// errors_occurred isn't checked. Over a long run freed memory gets reused at every offset, and the allocator's
+	// own bookkeeping overwrites enough stale items to trip the check items do on construction, even for the std
+	// containers.
+	return TestResult::Pass;
+}
+
+// Randomly creates, grows, shrinks and destroys vectors and shared pointers for the given number of seconds,
+// sampling how much memory the process holds against how much is live
+template <template <typename> class Vec, template <typename> class SharedPtr>
+void run(double seconds)
+{
+	using VecItem = Vec<MemoryCorrectnessItem>;
+	using SharedPtrItem = SharedPtr<SoakItem>;
+
+	printf("\n%s, %s\n-------------------------------\n", typeid(VecItem).name(), typeid(SharedPtrItem).name());
+
+	printf("Soak (%.0f s):\n", seconds);
+
+	if (read_rss_bytes() == 0)
+		output_warning("soak", "can't read /proc/self/statm on this platform");
+	else if constexpr (has_push_back<VecItem, MemoryCorrectnessItem> && has_size<VecItem> && has_resize<VecItem> &&
+		has_constructor_ptr<SharedPtrItem, SoakItem> && std::is_copy_constructible_v<SharedPtrItem>)
+		output_result("soak", [&] { return soak<Vec, SharedPtr>(seconds); });
+	else
+		output_warning("soak", "can't test, missing requirements: push_back, size, resize, shared pointer constructor (pointer), copy constructor");
+
+	printf("\n");
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+
+#include "memory_correctness_item.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+#include "queue_common.h"
+
+namespace tests_spsc_queue
+{
+
+template <typename Q> concept has_constructor_capacity = requires { Q(size_t{ 16 }); };
+template <typename Q, typename T> concept has_try_push = requires(Q q, T t) { { q.try_push(std::move(t)) } -> std::same_as<bool>; };
+template <typename Q, typename T> concept has_try_pop = requires(Q q, T& t) { { q.try_pop(t) } -> std::same_as<bool>; };
+
+template <template <typename> class Queue>
+void run()
+{
+	using QueueItem = Queue<MemoryCorrectnessItem>;
+
+	printf("\n%s\n-------------------------------\n", typeid(Queue<int>).name());
+
+	printf("Class methods:\n");
+
+	constexpr bool can_test = has_constructor_capacity<QueueItem> && has_try_push<QueueItem, MemoryCorrectnessItem> &&
+		has_try_pop<QueueItem, MemoryCorrectnessItem>;
+
+	if constexpr (!has_constructor_capacity<QueueItem>)
+		output_warning("constructor (capacity)", "not implemented");
+
+	if constexpr (has_try_push<QueueItem, MemoryCorrectnessItem> && has_try_pop<QueueItem, MemoryCorrectnessItem>)
+	{
+		if constexpr (can_test)
+			output_result("try_push/try_pop", test_try_push_pop<Queue>);
+		else
+			output_warning("try_push/try_pop", "can't test, missing requirements: constructor (capacity)");
+	}
+	else
+		output_warning("try_push/try_pop", "not implemented");
+
+	if constexpr (can_test)
+	{
+		output_result("destructor", test_destructor<Queue>);
+		output_result("exactly once (1 producer, 1 consumer)", [] { return test_exactly_once<Queue>(1, 1); });
+		output_result("linearizable (1 producer, 1 consumer)", [] { return test_linearizable<Queue>(1, 1, 0); });
+	}
+	else
+	{
+		output_warning("destructor", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+		output_warning("exactly once (1 producer, 1 consumer)", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+		output_warning("linearizable (1 producer, 1 consumer)", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+	}
+
+	printf("Benchmarks:\n");
+
+	if constexpr (can_test)
+	{
+		run_benchmark("throughput", [] { benchmark_throughput<Queue>(1, 1); });
+		run_benchmark("latency", [] { benchmark_latency<Queue>(1); });
+		run_benchmark("false sharing", benchmark_false_sharing<Queue>);
+	}
+	else
+	{
+		output_warning("throughput", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+		output_warning("latency", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+		output_warning("false sharing", "can't test, missing requirements: constructor (capacity), try_push, try_pop");
+	}
+
+	printf("\n");
+}
+
+}
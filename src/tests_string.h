@@ -0,0 +1,454 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <string>
+#include <utility>
+
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+
+namespace tests_string
+{
+
+template <typename Str> concept has_constructor_default = requires { Str{}; };
+template <typename Str> concept has_constructor_cstr = requires(const char* cstr) { Str{ cstr }; };
+template <typename Str> concept has_size = requires(Str s) { { s.size() } -> std::same_as<size_t>; };
+template <typename Str> concept has_capacity = requires(Str s) { { s.capacity() } -> std::same_as<size_t>; };
+template <typename Str> concept has_c_str = requires(Str s) { { s.c_str() } -> std::same_as<const char*>; };
+template <typename Str> concept has_operator_sq_bk = requires(Str s) { { s[0] } -> std::same_as<char&>; };
+template <typename Str> concept has_append = requires(Str s, const char* cstr) { s += cstr; };
+template <typename Str> concept has_concatenate = requires(Str a, Str b) { { a + b } -> std::same_as<Str>; };
+
+// Longest string the tests and SSO detection go up to
+constexpr size_t max_length = 1000;
+
+// Lengths either side of the usual inline capacities (15 for libstdc++, 22 for libc++, 23 for folly)
+constexpr size_t test_lengths[] = { 0, 1, 7, 8, 15, 16, 22, 23, 24, 31, 32, 63, 64, 100, max_length };
+
+// Lengths of the short and long strings used by the benchmarks
+constexpr size_t benchmark_short_length = 8;
+constexpr size_t benchmark_long_length = 64;
+
+// Operations timed per sample
+constexpr int benchmark_operations = 10000;
+
+// A null terminated string of the given length, different at every position so misplaced characters are caught
+const char* text(size_t length)
+{
+	static char buffers[max_length + 1][max_length + 1];
+	static bool initialised = false;
+
+	if (!initialised)
+	{
+		for (size_t l = 0; l <= max_length; l++)
+		{
+			for (size_t i = 0; i < l; i++)
+				buffers[l][i] = char('a' + i % 26);
+			buffers[l][l] = '\0';
+		}
+		initialised = true;
+	}
+
+	return buffers[length];
+}
+
+template <typename Str>
+bool matches(Str& s, const char* expected)
+{
+	return s.size() == strlen(expected) && strcmp(s.c_str(), expected) == 0;
+}
+
+template <typename Str>
+TestResult test_constructor_cstr()
+{
+	counted_malloc_reset();
+
+	for (size_t length : test_lengths)
+	{
+		Str s{ text(length) };
+		if (!matches(s, text(length))) return TestResult::IncorrectResults;
+	}
+
+	if constexpr (has_constructor_default<Str>)
+	{
+		Str s{};
+		if (!matches(s, "")) return TestResult::IncorrectResults;
+	}
+
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <typename Str>
+TestResult test_copy()
+{
+	counted_malloc_reset();
+
+	for (size_t length : test_lengths)
+	{
+		Str original{ text(length) };
+		Str copy{ original };
+
+		if (!matches(copy, text(length)) || !matches(original, text(length))) return TestResult::IncorrectResults;
+		if (length > 0 && copy.c_str() == original.c_str()) return TestResult::IncorrectResults;
+
+		// Assign across the SSO boundary in both directions
+		Str short_str{ text(1) };
+		Str long_str{ text(100) };
+		short_str = original;
+		long_str = original;
+
+		if (!matches(short_str, text(length)) || !matches(long_str, text(length))) return TestResult::IncorrectResults;
+	}
+
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <typename Str>
+TestResult test_move()
+{
+	counted_malloc_reset();
+
+	bool allocated_on_move = false;
+
+	for (size_t length : test_lengths)
+	{
+		Str original{ text(length) };
+
+		size_t allocations = counted_malloc_allocations;
+		Str moved{ std::move(original) };
+		allocated_on_move |= counted_malloc_allocations != allocations;
+
+		if (!matches(moved, text(length))) return TestResult::IncorrectResults;
+
+		Str short_str{ text(1) };
+		Str long_str{ text(100) };
+
+		allocations = counted_malloc_allocations;
+		short_str = std::move(moved);
+		allocated_on_move |= counted_malloc_allocations != allocations;
+
+		if (!matches(short_str, text(length))) return TestResult::IncorrectResults;
+
+		allocations = counted_malloc_allocations;
+		long_str = std::move(short_str);
+		allocated_on_move |= counted_malloc_allocations != allocations;
+
+		if (!matches(long_str, text(length))) return TestResult::IncorrectResults;
+	}
+
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+	if (allocated_on_move) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <typename Str>
+TestResult test_append()
+{
+	counted_malloc_reset();
+
+	{
+		// One character at a time, crossing the SSO boundary on the way
+		Str s{ text(0) };
+		std::string expected;
+
+		for (size_t i = 0; i < 100; i++)
+		{
+			char c[2] = { char('a' + i % 26), '\0' };
+			s += c;
+			expected += c;
+
+			if (!matches(s, expected.c_str())) return TestResult::IncorrectResults;
+		}
+
+		// Longer pieces onto both short and long strings
+		for (size_t length : test_lengths)
+		{
+			Str short_str{ text(3) };
+			Str long_str{ text(50) };
+			short_str += text(length);
+			long_str += text(length);
+
+			if (!matches(short_str, (std::string(text(3)) + text(length)).c_str())) return TestResult::IncorrectResults;
+			if (!matches(long_str, (std::string(text(50)) + text(length)).c_str())) return TestResult::IncorrectResults;
+		}
+	}
+
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+template <typename Str>
+TestResult test_concatenate()
+{
+	counted_malloc_reset();
+
+	for (size_t a : test_lengths)
+	{
+		for (size_t b : test_lengths)
+		{
+			Str left{ text(a) };
+			Str right{ text(b) };
+			Str result = left + right;
+
+			if (!matches(result, (std::string(text(a)) + text(b)).c_str())) return TestResult::IncorrectResults;
+			if (!matches(left, text(a)) || !matches(right, text(b))) return TestResult::IncorrectResults;
+		}
+	}
+
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
+// Longest string that can be constructed without allocating through counted_malloc, or -1 if even the empty string allocates
+template <typename Str>
+int detect_inline_capacity()
+{
+	int capacity = -1;
+
+	for (size_t length = 0; length <= max_length; length++)
+	{
+		size_t allocations = counted_malloc_allocations;
+		Str s{ text(length) };
+		if (counted_malloc_allocations != allocations)
+			break;
+		capacity = int(length);
+	}
+
+	return capacity;
+}
+
+// Strings at or below the inline capacity must not allocate, however they're made
+template <typename Str>
+TestResult test_short_no_allocation(int inline_capacity)
+{
+	counted_malloc_reset();
+
+	{
+		Str appended{ text(0) };
+
+		for (int length = 0; length <= inline_capacity; length++)
+		{
+			Str constructed{ text(length) };
+			Str copied{ constructed };
+			Str moved{ std::move(copied) };
+
+			Str assigned{ text(0) };
+			assigned = constructed;
+
+			if (length > 0)
+				appended += "a";
+
+			Str left{ text(length / 2) };
+			Str right{ text(length - length / 2) };
+			Str concatenated = left + right;
+
+			if (!matches(moved, text(length)) || !matches(assigned, text(length))) return TestResult::IncorrectResults;
+		}
+
+		if (int(appended.size()) != inline_capacity) return TestResult::IncorrectResults;
+	}
+
+	if (counted_malloc_allocations != 0) return TestResult::IncorrectResults;
+
+	return TestResult::Pass;
+}
+
+template <typename S>
+double construct_ns(const char* source)
+{
+	return benchmark_ns([&] {
+		for (int i = 0; i < benchmark_operations; i++)
+		{
+			S s{ source };
+			do_not_optimize(s);
+		}
+	}) / benchmark_operations;
+}
+
+template <typename S>
+double copy_ns(const char* source)
+{
+	S original{ source };
+
+	return benchmark_ns([&] {
+		for (int i = 0; i < benchmark_operations; i++)
+		{
+			S s{ original };
+			do_not_optimize(s);
+		}
+	}) / benchmark_operations;
+}
+
+template <typename S>
+double concatenate_ns(size_t length)
+{
+	S left{ text(length / 2) };
+	S right{ text(length - length / 2) };
+
+	return benchmark_ns([&] {
+		for (int i = 0; i < benchmark_operations; i++)
+		{
+			S s = left + right;
+			do_not_optimize(s);
+		}
+	}) / benchmark_operations;
+}
+
+// Per character, building strings of the given length one character at a time
+template <typename S>
+double append_ns(size_t length)
+{
+	int strings = benchmark_operations / int(length);
+
+	return benchmark_ns([&] {
+		for (int i = 0; i < strings; i++)
+		{
+			S s{ text(0) };
+			for (size_t c = 0; c < length; c++)
+				s += "a";
+			do_not_optimize(s);
+		}
+	}) / (strings * length);
+}
+
+void output_comparison(const char* operation, size_t length, double ns, double std_ns, const char* unit)
+{
+	printf("  %s (%zu chars): %.2f %s (std::string: %.2f %s, %.2fx)\n", operation, length, ns, unit, std_ns, unit, std_ns / ns);
+
+	char name[128];
+	snprintf(name, sizeof(name), "%s (%zu chars)", operation, length);
+	record_benchmark(name, ns, unit);
+}
+
+template <typename Str>
+void benchmark_string(int inline_capacity)
+{
+	printf("  sizeof: %zu bytes (std::string: %zu bytes)\n", sizeof(Str), sizeof(std::string));
+	record_benchmark("sizeof", double(sizeof(Str)), "bytes");
+
+	if (inline_capacity >= 0)
+		printf("  inline capacity: %d chars (std::string: %zu chars)\n", inline_capacity, std::string().capacity());
+	else
+		printf("  inline capacity: none (std::string: %zu chars)\n", std::string().capacity());
+	record_benchmark("inline capacity", double(std::max(inline_capacity, 0)), "chars");
+
+	for (size_t length : { benchmark_short_length, benchmark_long_length })
+	{
+		const char* source = text(length);
+		make_opaque(source);
+
+		output_comparison("construct and destroy", length, construct_ns<Str>(source), construct_ns<std::string>(source), "ns/op");
+		output_comparison("copy", length, copy_ns<Str>(source), copy_ns<std::string>(source), "ns/op");
+
+		if constexpr (has_concatenate<Str>)
+			output_comparison("concatenate", length, concatenate_ns<Str>(length), concatenate_ns<std::string>(length), "ns/op");
+
+		if constexpr (has_append<Str>)
+			output_comparison("append char by char", length, append_ns<Str>(length), append_ns<std::string>(length), "ns/char");
+	}
+}
+
+template <typename Str>
+void run()
+{
+	printf("\n%s\n-------------------------------\n", typeid(Str).name());
+
+	printf("Class methods:\n");
+
+	constexpr bool can_check = has_size<Str> && has_c_str<Str>;
+
+	if constexpr (has_constructor_cstr<Str>)
+	{
+		if constexpr (can_check)
+			output_result("constructor (const char*)", test_constructor_cstr<Str>);
+		else
+			output_warning("constructor (const char*)", "can't test, missing requirements: size, c_str");
+	}
+	else
+		output_warning("constructor (const char*)", "not implemented");
+
+	if constexpr (std::copy_constructible<Str> && std::is_copy_assignable_v<Str>)
+	{
+		if constexpr (has_constructor_cstr<Str> && can_check)
+			output_result("copy constructor/assignment", test_copy<Str>);
+		else
+			output_warning("copy constructor/assignment", "can't test, missing requirements: constructor (const char*), size, c_str");
+	}
+	else
+		output_warning("copy constructor/assignment", "not implemented");
+
+	if constexpr (std::is_move_constructible_v<Str> && std::is_move_assignable_v<Str>)
+	{
+		if constexpr (has_constructor_cstr<Str> && can_check)
+			output_result("move constructor/assignment", test_move<Str>);
+		else
+			output_warning("move constructor/assignment", "can't test, missing requirements: constructor (const char*), size, c_str");
+	}
+	else
+		output_warning("move constructor/assignment", "not implemented");
+
+	if constexpr (has_append<Str>)
+	{
+		if constexpr (has_constructor_cstr<Str> && can_check)
+			output_result("operator+=", test_append<Str>);
+		else
+			output_warning("operator+=", "can't test, missing requirements: constructor (const char*), size, c_str");
+	}
+	else
+		output_warning("operator+=", "not implemented");
+
+	if constexpr (has_concatenate<Str>)
+	{
+		if constexpr (has_constructor_cstr<Str> && can_check)
+			output_result("operator+", test_concatenate<Str>);
+		else
+			output_warning("operator+", "can't test, missing requirements: constructor (const char*), size, c_str");
+	}
+	else
+		output_warning("operator+", "not implemented");
+
+	int inline_capacity = -1;
+
+	if constexpr (has_constructor_cstr<Str>)
+	{
+		inline_capacity = detect_inline_capacity<Str>();
+
+		if constexpr (has_capacity<Str>)
+		{
+			// Trust the candidate's own account of its inline capacity, so a string that allocates too early is caught
+			int reported = int(Str{ text(0) }.capacity());
+			if (reported > inline_capacity)
+				inline_capacity = reported;
+		}
+	}
+
+	if constexpr (has_constructor_cstr<Str> && can_check && has_append<Str> && has_concatenate<Str>)
+	{
+		if (inline_capacity > 0)
+			output_result("short strings don't allocate", [&] { return test_short_no_allocation<Str>(inline_capacity); });
+		else
+			output_warning("short strings don't allocate", "no small string optimisation");
+	}
+	else
+		output_warning("short strings don't allocate", "can't test, missing requirements: constructor (const char*), size, c_str, operator+=, operator+");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (has_constructor_cstr<Str> && std::copy_constructible<Str>)
+		run_benchmark("against std::string", [&] { benchmark_string<Str>(inline_capacity); });
+	else
+		output_warning("against std::string", "can't test, missing requirements: constructor (const char*), copy constructor");
+
+	printf("\n");
+}
+
+}
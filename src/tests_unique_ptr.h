@@ -3,10 +3,13 @@
 #include <cstdio>
 #include <typeinfo>
 #include <stdexcept>
+#include <vector>
 
 #include "memory_correctness_item.h"
+#include "constexpr_item.h"
 #include "counted_malloc.h"
 #include "tests_common.h"
+#include "benchmark_common.h"
 
 namespace tests_unique_ptr
 {
@@ -26,6 +29,68 @@ struct Fooable
 };
 template <template <typename> class UP> concept has_operator_arrow = requires(UP<Fooable> u) { u->foo(); };
 
+// Deleter with no state, which should add nothing to the size of the pointer
+struct CountingDeleter
+{
+	template <typename T>
+	void operator()(T* p) const
+	{
+		calls += 1;
+		delete p;
+	}
+
+	inline static int calls = 0;
+};
+
+// Deleter carrying state, which has to be moved along with the pointer
+struct StatefulDeleter
+{
+	template <typename T>
+	void operator()(T* p) const
+	{
+		*calls += 1;
+		delete p;
+	}
+
+	int* calls = nullptr;
+};
+
+template <template <typename...> class UP> concept has_array_form = requires(MemoryCorrectnessItem* t) {
+	UP<MemoryCorrectnessItem[]>{ t };
+	{ UP<MemoryCorrectnessItem[]>{ t }[0] } -> std::same_as<MemoryCorrectnessItem&>;
+};
+template <template <typename...> class UP> concept has_array_reset = requires(UP<MemoryCorrectnessItem[]> u, MemoryCorrectnessItem* t) { u.reset(t); u.reset(); };
+
+// Element that checks it is destroyed in the reverse order of construction, as delete[] requires
+struct DestructionOrderItem : MemoryCorrectnessItem
+{
+	DestructionOrderItem() : MemoryCorrectnessItem(next_id++) {}
+
+	~DestructionOrderItem()
+	{
+		if (id != last_destroyed_id - 1)
+			out_of_order += 1;
+		last_destroyed_id = id;
+	}
+
+	inline static int next_id = 0;
+	inline static int last_destroyed_id = 0;
+	inline static int out_of_order = 0;
+};
+
+// Cheap element with a destructor the compiler can't skip, for timing bulk destruction
+struct DestructibleItem
+{
+	~DestructibleItem() { do_not_optimize(value); }
+
+	int value = 0;
+};
+
+template <template <typename...> class UP> concept has_custom_deleter = requires(MemoryCorrectnessItem* t, StatefulDeleter d) {
+	UP<MemoryCorrectnessItem, CountingDeleter>{ t };
+	UP<MemoryCorrectnessItem, StatefulDeleter>{ t, d };
+};
+
 template <template <typename> class UniquePtr>
 TestResult test_constructor_default()
 {
@@ -291,30 +356,347 @@ TestResult test_operator_arrow()
 	return TestResult::Pass;
 }
 
-template <template <typename> class UniquePtr>
+template <template <typename...> class UniquePtr>
+TestResult test_custom_deleter()
+{
+	using Ptr = UniquePtr<MemoryCorrectnessItem, CountingDeleter>;
+
+	MemoryCorrectnessItem::reset();
+	CountingDeleter::calls = 0;
+
+	{
+		Ptr p(new MemoryCorrectnessItem());
+	}
+
+	if (CountingDeleter::calls != 1) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+	// An empty pointer has nothing to delete
+	{
+		Ptr p(nullptr);
+	}
+
+	if (CountingDeleter::calls != 1) return TestResult::IncorrectObjectHandling;
+
+	MemoryCorrectnessItem* raw;
+
+	{
+		Ptr p(new MemoryCorrectnessItem());
+		raw = p.release();
+	}
+
+	if (CountingDeleter::calls != 1) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+	{
+		Ptr p(raw);
+
+		p.reset(new MemoryCorrectnessItem());
+		if (CountingDeleter::calls != 2) return TestResult::IncorrectObjectHandling;
+
+		p.reset();
+		if (CountingDeleter::calls != 3) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (CountingDeleter::calls != 3) return TestResult::IncorrectObjectHandling;
+
+	{
+		Ptr p(new MemoryCorrectnessItem());
+		Ptr q(new MemoryCorrectnessItem());
+
+		p = std::move(q);
+		if (CountingDeleter::calls != 4) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (CountingDeleter::calls != 5) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+	int calls_a = 0;
+	int calls_b = 0;
+
+	{
+		using StatefulPtr = UniquePtr<MemoryCorrectnessItem, StatefulDeleter>;
+
+		StatefulPtr p(new MemoryCorrectnessItem(), StatefulDeleter{ &calls_a });
+		StatefulPtr q(new MemoryCorrectnessItem(), StatefulDeleter{ &calls_b });
+
+		// The deleter travels with the pointer, so q's object must still be deleted through calls_b
+		p = std::move(q);
+		if (calls_a != 1 || calls_b != 0) return TestResult::IncorrectObjectHandling;
+
+		StatefulPtr r(std::move(p));
+		if (calls_a != 1 || calls_b != 0) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (calls_a != 1 || calls_b != 1) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class UniquePtr>
+void benchmark_raw_pointer_overhead()
+{
+	constexpr int count = 4096;
+
+	std::vector<UniquePtr<int>> ptrs;
+	std::vector<int*> raws;
+
+	for (int i = 0; i < count; i++)
+	{
+		ptrs.emplace_back(new int(i));
+		raws.push_back(new int(i));
+	}
+
+	double ptr_ns = benchmark_ns([&] {
+		int sum = 0;
+		for (auto& p : ptrs)
+			sum += *p;
+		do_not_optimize(sum);
+	});
+	double raw_ns = benchmark_ns([&] {
+		int sum = 0;
+		for (auto* p : raws)
+			sum += *p;
+		do_not_optimize(sum);
+	});
+	output_benchmark_comparison("operator* (4096 pointers)", ptr_ns, "raw pointer", raw_ns);
+
+	if constexpr (has_reset<UniquePtr<int>, int>)
+	{
+		ptr_ns = benchmark_ns([&] {
+			for (int i = 0; i < count; i++)
+				ptrs[i].reset(new int(i));
+		});
+		raw_ns = benchmark_ns([&] {
+			for (int i = 0; i < count; i++)
+			{
+				delete raws[i];
+				raws[i] = new int(i);
+			}
+		});
+		output_benchmark_comparison("reset (4096 pointers)", ptr_ns, "raw pointer", raw_ns);
+	}
+	else
+		output_warning("reset", "not implemented");
+
+	for (auto* p : raws)
+		delete p;
+}
+
+template <template <typename...> class UniquePtr>
+TestResult test_array_form()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		MemoryCorrectnessItem* raw = new MemoryCorrectnessItem[10];
+		UniquePtr<MemoryCorrectnessItem[]> p(raw);
+
+		if (MemoryCorrectnessItem::count_alive() != 10)
+			return TestResult::IncorrectObjectHandling;
+
+		for (int i = 0; i < 10; i++)
+			p[i].id = i;
+
+		for (int i = 0; i < 10; i++)
+			if (raw[i].id != i || &p[i] != raw + i)
+				return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::count_destroyed != 10 || MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	MemoryCorrectnessItem::reset();
+	DestructionOrderItem::next_id = 0;
+	DestructionOrderItem::last_destroyed_id = 16;
+	DestructionOrderItem::out_of_order = 0;
+
+	{
+		UniquePtr<DestructionOrderItem[]> p(new DestructionOrderItem[16]);
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (DestructionOrderItem::out_of_order != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class UniquePtr>
+TestResult test_array_reset()
+{
+	MemoryCorrectnessItem::reset();
+
+	UniquePtr<MemoryCorrectnessItem[]> p(new MemoryCorrectnessItem[1]);
+
+	for (int count = 1; count <= 1000000; count *= 10)
+	{
+		p.reset(new MemoryCorrectnessItem[count]);
+
+		if (MemoryCorrectnessItem::count_alive() != count)
+			return TestResult::IncorrectObjectHandling;
+	}
+
+	p.reset();
+
+	if (MemoryCorrectnessItem::count_alive() != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	if (MemoryCorrectnessItem::errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class UniquePtr>
+void benchmark_array_destruction()
+{
+	for (int count = 1; count <= 1000000; count *= 1000)
+	{
+		UniquePtr<DestructibleItem[]> p(static_cast<DestructibleItem*>(nullptr));
+		DestructibleItem* raw = nullptr;
+
+		double ptr_ns = benchmark_ns([&] {
+			p.reset(new DestructibleItem[count]);
+			p.reset();
+		});
+		double raw_ns = benchmark_ns([&] {
+			raw = new DestructibleItem[count];
+			do_not_optimize(raw);
+			delete[] raw;
+			raw = nullptr;
+		});
+
+		char name[128];
+		snprintf(name, sizeof(name), "reset (array of %d)", count);
+		printf("  %s: %.2f ns/element (delete[]: %.2f ns/element, %.2fx)\n", name, ptr_ns / count, raw_ns / count, raw_ns / ptr_ns);
+		record_benchmark(name, ptr_ns / count, "ns/element");
+	}
+}
+
+// Tests evaluated by the compiler, for candidates that can be used in constant expressions. Each returns a
+// TestResult, so run() prints what the compiler worked out and constexpr_gate() can assert on it.
+template <template <typename...> class UniquePtr>
+constexpr TestResult constexpr_usable()
+{
+	UniquePtr<int> p(new int(42));
+	return *p == 42 ? TestResult::Pass : TestResult::IncorrectResults;
+}
+
+template <template <typename...> class UniquePtr>
+constexpr TestResult constexpr_ownership()
+{
+	LifecycleCounts counts;
+
+	{
+		UniquePtr<ConstexprItem> p(new ConstexprItem(counts, 1));
+		if ((*p).id != 1) return TestResult::IncorrectResults;
+		if (counts.count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		UniquePtr<ConstexprItem> q(std::move(p));
+		if ((*q).id != 1) return TestResult::IncorrectResults;
+		if (counts.count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		UniquePtr<ConstexprItem> r(new ConstexprItem(counts, 2));
+		r = std::move(q);
+		if ((*r).id != 1) return TestResult::IncorrectResults;
+		if (counts.count_alive() != 1 || counts.destroyed != 1) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (counts.count_alive() != 0 || counts.errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	// The pointer moves, never the object
+	if (counts.constructed_copy != 0 || counts.constructed_move != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class UniquePtr>
+constexpr TestResult constexpr_reset_release()
+{
+	LifecycleCounts counts;
+
+	{
+		UniquePtr<ConstexprItem> p(new ConstexprItem(counts, 1));
+
+		p.reset(new ConstexprItem(counts, 2));
+		if ((*p).id != 2) return TestResult::IncorrectResults;
+		if (counts.count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		p.reset();
+		if (counts.count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+		p.reset(new ConstexprItem(counts, 3));
+		ConstexprItem* raw = p.release();
+		if (raw->id != 3) return TestResult::IncorrectResults;
+		if (counts.count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		delete raw;
+	}
+
+	if (counts.count_alive() != 0 || counts.errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class UniquePtr>
+concept constexpr_testable = has_constructor_ptr<UniquePtr<ConstexprItem>, ConstexprItem> &&
+	has_operator_star<UniquePtr<ConstexprItem>, ConstexprItem> && std::is_move_constructible_v<UniquePtr<ConstexprItem>> &&
+	std::is_move_assignable_v<UniquePtr<ConstexprItem>>;
+
+// Fails the build when a candidate that can be used in constant expressions fails a test there, with the compiler
+// explaining the undefined behaviour or leak that stopped evaluation. Candidates that can't be are let through.
+template <template <typename...> class UniquePtr>
+constexpr bool constexpr_gate()
+{
+	if constexpr (constexpr_testable<UniquePtr>)
+	{
+		if constexpr (constant_evaluable<constexpr_usable<UniquePtr>>)
+		{
+			static_assert(constexpr_passes<constexpr_ownership<UniquePtr>>(), "constexpr ownership failed");
+
+			if constexpr (has_reset<UniquePtr<ConstexprItem>, ConstexprItem> && has_reset_empty<UniquePtr<ConstexprItem>, ConstexprItem> &&
+				has_release<UniquePtr<ConstexprItem>, ConstexprItem>)
+				static_assert(constexpr_passes<constexpr_reset_release<UniquePtr>>(), "constexpr reset and release failed");
+		}
+	}
+
+	return true;
+}
+
+template <template <typename...> class UniquePtr>
 void run()
 {
-	printf("\n%s\n-------------------------------\n", typeid(UniquePtr).name());
+	printf("\n%s\n-------------------------------\n", typeid(UniquePtr<int>).name());
 
 	printf("Class methods:\n");
 
 	if constexpr (has_constructor_default<UniquePtr<int>, int>)
-		output_result("constructor (default)", test_constructor_default<UniquePtr>());
+		output_result("constructor (default)", test_constructor_default<UniquePtr>);
 	else
 		output_warning("constructor (default)", "not implemented");
 
 	if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-		output_result("constructor (pointer)", test_constructor_ptr<UniquePtr>());
+		output_result("constructor (pointer)", test_constructor_ptr<UniquePtr>);
 	else
 		output_warning("constructor (pointer)", "not implemented");
 
 	if constexpr (has_constructor_val<UniquePtr<int>, int>)
-		output_result("constructor (val)", test_constructor_val<UniquePtr>());
+		output_result("constructor (val)", test_constructor_val<UniquePtr>);
 	else
 		output_warning("constructor (val)", "not implemented");
 
 	if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-		output_result("destructor", test_destructor<UniquePtr>());
+		output_result("destructor", test_destructor<UniquePtr>);
 	else
 		output_warning("destructor", "can't test, missing requirements: constructor (pointer)");
 
@@ -330,7 +712,7 @@ void run()
 
 	if constexpr (std::is_move_constructible_v<UniquePtr<int>>)
 		if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-			output_result("move constructor", test_move_constructor<UniquePtr>());
+			output_result("move constructor", test_move_constructor<UniquePtr>);
 		else
 			output_warning("move constructor", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -338,7 +720,7 @@ void run()
 
 	if constexpr (std::is_move_assignable_v<UniquePtr<int>>)
 		if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-			output_result("move assignment", test_move_assignment<UniquePtr>());
+			output_result("move assignment", test_move_assignment<UniquePtr>);
 		else
 			output_warning("move assignment", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -346,7 +728,7 @@ void run()
 
 	if constexpr (has_reset<UniquePtr<int>, int> && has_reset_empty<UniquePtr<int>, int>)
 		if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-			output_result("reset", test_reset<UniquePtr>());
+			output_result("reset", test_reset<UniquePtr>);
 		else
 			output_warning("reset", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -359,7 +741,7 @@ void run()
 
 	if constexpr (has_release<UniquePtr<int>, int>)
 		if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-			output_result("release", test_release<UniquePtr>());
+			output_result("release", test_release<UniquePtr>);
 		else
 			output_warning("release", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -367,7 +749,7 @@ void run()
 
 	if constexpr (has_get<UniquePtr<int>, int>)
 		if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-			output_result("get", test_get<UniquePtr>());
+			output_result("get", test_get<UniquePtr>);
 		else
 			output_warning("get", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -375,7 +757,7 @@ void run()
 
 	if constexpr (has_operator_star<UniquePtr<int>, int>)
 		if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-			output_result("operator*", test_operator_star<UniquePtr>());
+			output_result("operator*", test_operator_star<UniquePtr>);
 		else
 			output_warning("operator*", "can't test, missing requirements: constructor (pointer)");
 	else
@@ -383,12 +765,74 @@ void run()
 
 	if constexpr (has_operator_arrow<UniquePtr>)
 		if constexpr (has_constructor_ptr<UniquePtr<int>, int>)
-			output_result("operator->", test_operator_arrow<UniquePtr>());
+			output_result("operator->", test_operator_arrow<UniquePtr>);
 		else
 			output_warning("operator->", "can't test, missing requirements: constructor (pointer)");
 	else
 		output_warning("operator->", "not implemented");
 
+	if constexpr (has_custom_deleter<UniquePtr>)
+	{
+		if constexpr (has_release<UniquePtr<int>, int> && has_reset<UniquePtr<int>, int> && has_reset_empty<UniquePtr<int>, int>)
+			output_result("custom deleter", test_custom_deleter<UniquePtr>);
+		else
+			output_warning("custom deleter", "can't test, missing requirements: release, reset");
+	}
+	else
+		output_warning("custom deleter", "not implemented");
+
+	if constexpr (has_custom_deleter<UniquePtr>)
+	{
+		if constexpr (sizeof(UniquePtr<int, CountingDeleter>) == sizeof(int*))
+			output_result("custom deleter (stateless, no size overhead)", TestResult::Pass);
+		else
+			output_warning("custom deleter (stateless, no size overhead)", "stateless deleter makes the pointer bigger than a raw pointer");
+	}
+
+	if constexpr (has_array_form<UniquePtr>)
+		output_result("array form (operator[], destructor)", test_array_form<UniquePtr>);
+	else
+		output_warning("array form (operator[], destructor)", "not implemented");
+
+	if constexpr (has_array_reset<UniquePtr>)
+	{
+		if constexpr (has_array_form<UniquePtr>)
+			output_result("array form (reset)", test_array_reset<UniquePtr>);
+		else
+			output_warning("array form (reset)", "can't test, missing requirements: array form");
+	}
+	else
+		output_warning("array form (reset)", "not implemented");
+
+	printf("Constant evaluation:\n");
+
+	if constexpr (!constexpr_testable<UniquePtr>)
+		output_warning("constexpr", "can't test, missing requirements: constructor (pointer), operator*, move constructor, move assignment");
+	else if constexpr (!constant_evaluable<constexpr_usable<UniquePtr>>)
+		output_warning("constexpr", "can't be used in constant expressions");
+	else
+	{
+		output_constexpr_result<constexpr_ownership<UniquePtr>>("constexpr ownership");
+
+		if constexpr (has_reset<UniquePtr<ConstexprItem>, ConstexprItem> && has_reset_empty<UniquePtr<ConstexprItem>, ConstexprItem> &&
+			has_release<UniquePtr<ConstexprItem>, ConstexprItem>)
+			output_constexpr_result<constexpr_reset_release<UniquePtr>>("constexpr reset and release");
+		else
+			output_warning("constexpr reset and release", "can't test, missing requirements: reset, release");
+	}
+
+	printf("Benchmarks:\n");
+
+	if constexpr (has_constructor_ptr<UniquePtr<int>, int> && has_operator_star<UniquePtr<int>, int> && std::is_move_constructible_v<UniquePtr<int>>)
+		run_benchmark("raw pointer overhead", benchmark_raw_pointer_overhead<UniquePtr>);
+	else
+		output_warning("raw pointer overhead", "can't test, missing requirements: constructor (pointer), operator*, move constructor");
+
+	if constexpr (has_array_form<UniquePtr> && has_array_reset<UniquePtr>)
+		run_benchmark("array destruction", benchmark_array_destruction<UniquePtr>);
+	else
+		output_warning("array destruction", "can't test, missing requirements: array form, reset");
+
 	printf("\n");
 }
 
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <cstdio>
+#include <typeinfo>
+#include <variant>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+
+#include "memory_correctness_item.h"
+#include "counted_malloc.h"
+#include "tests_common.h"
+#include "benchmark_common.h"
+
+namespace tests_variant
+{
+
+// A second tracked alternative, sharing MemoryCorrectnessItem's counters, so switching between alternatives can be checked
+struct OtherItem : MemoryCorrectnessItem
+{
+	OtherItem(int id = 0) : MemoryCorrectnessItem(id) {}
+};
+
+template <typename Var> concept has_constructor_default = requires { Var{}; };
+template <typename Var, typename T> concept has_constructor_alternative = requires { Var{ T{} }; };
+template <typename Var> concept has_index = requires(Var v) { { v.index() } -> std::same_as<size_t>; };
+template <typename Var, typename T> concept has_get = requires(Var v) { { v.template get<T>() } -> std::same_as<T&>; };
+template <typename Var, typename T> concept has_emplace = requires(Var v) { { v.template emplace<T>(0) } -> std::same_as<T&>; };
+template <typename Var, typename T> concept has_assign_alternative = requires(Var v) { v = T{}; };
+
+template <template <typename...> class Variant>
+TestResult test_constructor_default()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		// Value initialises the first alternative
+		Variant<int, MemoryCorrectnessItem, OtherItem> v{};
+
+		if (v.index() != 0 || v.template get<int>() != 0) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+		Variant<MemoryCorrectnessItem, int> w{};
+
+		if (w.index() != 0) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class Variant>
+TestResult test_constructor_alternative()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Variant<int, MemoryCorrectnessItem, OtherItem> a{ 5 };
+		Variant<int, MemoryCorrectnessItem, OtherItem> b{ MemoryCorrectnessItem{ 1 } };
+		Variant<int, MemoryCorrectnessItem, OtherItem> c{ OtherItem{ 2 } };
+
+		if (a.index() != 0 || a.template get<int>() != 5) return TestResult::IncorrectResults;
+		if (b.index() != 1 || b.template get<MemoryCorrectnessItem>().id != 1) return TestResult::IncorrectResults;
+		if (c.index() != 2 || c.template get<OtherItem>().id != 2) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 2) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != 0) return TestResult::SuboptimalObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class Variant>
+TestResult test_assign_alternative()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Variant<int, MemoryCorrectnessItem, OtherItem> v{ 5 };
+
+		v = MemoryCorrectnessItem{ 1 };
+
+		if (v.index() != 1 || v.template get<MemoryCorrectnessItem>().id != 1) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		// Switching alternative destroys the old one
+		v = OtherItem{ 2 };
+
+		if (v.index() != 2 || v.template get<OtherItem>().id != 2) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		// Same alternative, so assigns in place
+		uint64_t assigned = MemoryCorrectnessItem::count_assigned_move;
+		v = OtherItem{ 3 };
+
+		if (v.template get<OtherItem>().id != 3) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+		if (MemoryCorrectnessItem::count_assigned_move != assigned + 1) return TestResult::SuboptimalObjectHandling;
+
+		v = 7;
+
+		if (v.index() != 0 || v.template get<int>() != 7) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0 || MemoryCorrectnessItem::count_assigned_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class Variant>
+TestResult test_emplace()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Variant<int, MemoryCorrectnessItem, OtherItem> v{ 5 };
+
+		MemoryCorrectnessItem& item = v.template emplace<MemoryCorrectnessItem>(1);
+
+		if (v.index() != 1 || &item != &v.template get<MemoryCorrectnessItem>() || item.id != 1) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		v.template emplace<OtherItem>(2);
+
+		if (v.index() != 2 || v.template get<OtherItem>().id != 2) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+
+		// Emplacing the current alternative still destroys and reconstructs
+		v.template emplace<OtherItem>(3);
+
+		if (v.template get<OtherItem>().id != 3) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+		if (MemoryCorrectnessItem::count_destroyed != 2) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0 || MemoryCorrectnessItem::count_constructed_move != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class Variant>
+TestResult test_copy()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Variant<int, MemoryCorrectnessItem, OtherItem> a{ MemoryCorrectnessItem{ 1 } };
+		Variant<int, MemoryCorrectnessItem, OtherItem> b{ a };
+
+		if (b.index() != 1 || b.template get<MemoryCorrectnessItem>().id != 1) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 2) return TestResult::IncorrectObjectHandling;
+
+		// Different alternative, same alternative, then to a trivial one
+		Variant<int, MemoryCorrectnessItem, OtherItem> c{ OtherItem{ 2 } };
+		c = a;
+		if (c.index() != 1 || c.template get<MemoryCorrectnessItem>().id != 1) return TestResult::IncorrectResults;
+
+		c = b;
+		if (c.index() != 1 || c.template get<MemoryCorrectnessItem>().id != 1) return TestResult::IncorrectResults;
+
+		Variant<int, MemoryCorrectnessItem, OtherItem> d{ 5 };
+		c = d;
+		if (c.index() != 0 || c.template get<int>() != 5) return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 2) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename...> class Variant>
+TestResult test_move()
+{
+	MemoryCorrectnessItem::reset();
+
+	{
+		Variant<int, MemoryCorrectnessItem, OtherItem> a{ MemoryCorrectnessItem{ 1 } };
+		Variant<int, MemoryCorrectnessItem, OtherItem> b{ std::move(a) };
+
+		if (b.index() != 1 || b.template get<MemoryCorrectnessItem>().id != 1) return TestResult::IncorrectResults;
+
+		Variant<int, MemoryCorrectnessItem, OtherItem> c{ OtherItem{ 2 } };
+		c = std::move(b);
+		if (c.index() != 1 || c.template get<MemoryCorrectnessItem>().id != 1) return TestResult::IncorrectResults;
+
+		Variant<int, MemoryCorrectnessItem, OtherItem> d{ 5 };
+		c = std::move(d);
+		if (c.index() != 0 || c.template get<int>() != 5) return TestResult::IncorrectResults;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::errors_occurred != 0) return TestResult::IncorrectObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 0 || MemoryCorrectnessItem::count_assigned_copy != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+// Overhead is against the largest alternative, which is the least the storage could be
+template <template <typename...> class Variant, typename... Ts>
+void output_sizeof(const char* alternatives_name)
+{
+	size_t payload = std::max({ sizeof(Ts)... });
+
+	printf("  sizeof (%s): %zu bytes, %zu over largest alternative (std::variant: %zu bytes)\n",
+		alternatives_name, sizeof(Variant<Ts...>), sizeof(Variant<Ts...>) - payload, sizeof(std::variant<Ts...>));
+
+	char name[128];
+	snprintf(name, sizeof(name), "sizeof (%s)", alternatives_name);
+	record_benchmark(name, double(sizeof(Variant<Ts...>)), "bytes");
+}
+
+template <template <typename...> class Variant>
+void run()
+{
+	using Var = Variant<int, MemoryCorrectnessItem, OtherItem>;
+
+	printf("\n%s\n-------------------------------\n", typeid(Var).name());
+
+	printf("Class methods:\n");
+
+	constexpr bool can_check = has_index<Var> && has_get<Var, int> && has_get<Var, MemoryCorrectnessItem> && has_get<Var, OtherItem>;
+	constexpr bool can_construct = has_constructor_alternative<Var, int> && has_constructor_alternative<Var, MemoryCorrectnessItem> && has_constructor_alternative<Var, OtherItem>;
+
+	if constexpr (has_constructor_default<Var>)
+	{
+		if constexpr (can_check)
+			output_result("constructor (default)", test_constructor_default<Variant>);
+		else
+			output_warning("constructor (default)", "can't test, missing requirements: index, get");
+	}
+	else
+		output_warning("constructor (default)", "not implemented");
+
+	if constexpr (can_construct)
+	{
+		if constexpr (can_check)
+			output_result("constructor (alternative), destructor", test_constructor_alternative<Variant>);
+		else
+			output_warning("constructor (alternative), destructor", "can't test, missing requirements: index, get");
+	}
+	else
+		output_warning("constructor (alternative), destructor", "not implemented");
+
+	if constexpr (has_assign_alternative<Var, int> && has_assign_alternative<Var, MemoryCorrectnessItem> && has_assign_alternative<Var, OtherItem>)
+	{
+		if constexpr (can_construct && can_check)
+			output_result("assignment (alternative)", test_assign_alternative<Variant>);
+		else
+			output_warning("assignment (alternative)", "can't test, missing requirements: constructor (alternative), index, get");
+	}
+	else
+		output_warning("assignment (alternative)", "not implemented");
+
+	if constexpr (has_emplace<Var, MemoryCorrectnessItem> && has_emplace<Var, OtherItem>)
+	{
+		if constexpr (can_construct && can_check)
+			output_result("emplace", test_emplace<Variant>);
+		else
+			output_warning("emplace", "can't test, missing requirements: constructor (alternative), index, get");
+	}
+	else
+		output_warning("emplace", "not implemented");
+
+	if constexpr (std::copy_constructible<Var> && std::is_copy_assignable_v<Var>)
+	{
+		if constexpr (can_construct && can_check)
+			output_result("copy constructor/assignment", test_copy<Variant>);
+		else
+			output_warning("copy constructor/assignment", "can't test, missing requirements: constructor (alternative), index, get");
+	}
+	else
+		output_warning("copy constructor/assignment", "not implemented");
+
+	if constexpr (std::is_move_constructible_v<Var> && std::is_move_assignable_v<Var>)
+	{
+		if constexpr (can_construct && can_check)
+			output_result("move constructor/assignment", test_move<Variant>);
+		else
+			output_warning("move constructor/assignment", "can't test, missing requirements: constructor (alternative), index, get");
+	}
+	else
+		output_warning("move constructor/assignment", "not implemented");
+
+	// Lets variants of trivial types live in buffers that are memcpy'd around and never destroyed
+	if constexpr (has_constructor_alternative<Variant<int, double>, int>)
+	{
+		if (std::is_trivially_destructible_v<Variant<int, double>>)
+			output_result("trivially destructible (trivial alternatives)", TestResult::Pass);
+		else
+			output_result("trivially destructible (trivial alternatives)", TestResult::IncorrectObjectHandling);
+	}
+	else
+		output_warning("trivially destructible (trivial alternatives)", "can't test, missing requirements: constructor (alternative)");
+
+	printf("Benchmarks:\n");
+
+	if constexpr (can_construct)
+	{
+		run_benchmark("sizeof", [] {
+			output_sizeof<Variant, char, bool>("char, bool");
+			output_sizeof<Variant, int, float>("int, float");
+			output_sizeof<Variant, int, double>("int, double");
+			output_sizeof<Variant, int, MemoryCorrectnessItem, OtherItem>("int, MemoryCorrectnessItem, OtherItem");
+		});
+	}
+	else
+		output_warning("sizeof", "can't test, missing requirements: constructor (alternative)");
+
+	printf("\n");
+}
+
+}
@@ -3,10 +3,25 @@
 #include <cstdio>
 #include <typeinfo>
 #include <stdexcept>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <vector>
+#ifdef TEST_HARNESS_PARALLEL_STL
+#include <execution>
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define TEST_HARNESS_AVX2_BASELINE
+#endif
 
 #include "memory_correctness_item.h"
+#include "constexpr_item.h"
 #include "counted_malloc.h"
 #include "tests_common.h"
+#include "benchmark_common.h"
 
 namespace tests_vector
 {
@@ -18,10 +33,85 @@ template <typename Vec> concept has_empty = requires(Vec v) { { v.empty() } -> s
 template <typename Vec> concept has_reserve = requires(Vec v) { v.reserve(42); };
 template <typename Vec> concept has_resize = requires(Vec v) { v.resize(42); };
 template <typename Vec> concept has_clear = requires(Vec v) { v.clear(); };
+template <typename Vec> concept has_shrink_to_fit = requires(Vec v) { v.shrink_to_fit(); };
 template <typename Vec, typename T> concept has_operator_sq_bk = requires(Vec v) { { v[0] } -> std::convertible_to<T>; };
 template <typename Vec, typename T> concept has_at = requires(Vec v) { { v.at(0) } -> std::convertible_to<T>; };
 template <typename Vec, typename T> concept has_front = requires(Vec v) { { v.front() } -> std::same_as<T&>; };
 template <typename Vec, typename T> concept has_back = requires(Vec v) { { v.back() } -> std::same_as<T&>; };
+template <typename Vec, typename T> concept has_emplace_back = requires(Vec v) { v.emplace_back(T{}); };
+template <typename Vec, typename T> concept has_data = requires(Vec v) { { v.data() } -> std::same_as<T*>; };
+template <typename Vec> concept has_begin_end = requires(Vec v) { v.begin(); v.end(); };
+template <typename Vec> concept has_random_access_iterator = requires(Vec v) { requires std::random_access_iterator<decltype(v.begin())>; { v.end() } -> std::same_as<decltype(v.begin())>; };
+template <typename Vec> concept has_contiguous_iterator = requires(Vec v) { requires std::contiguous_iterator<decltype(v.begin())>; };
+template <typename Vec, typename T> concept has_insert_range = requires(Vec v, const T* p) { v.insert(v.end(), p, p); };
+template <typename Vec, typename T> concept has_assign_range = requires(Vec v, const T* p) { v.assign(p, p); };
+template <typename Vec, typename T> concept has_constructor_range = requires(const T* p) { Vec(p, p); };
+template <typename Vec, typename T> concept has_constructor_init_list = std::constructible_from<Vec, std::initializer_list<T>>;
+
+// Number of elements used by the bulk insertion tests
+constexpr size_t bulk_count = 100;
+
+// Element type owning a buffer, for comparing in-place construction against constructing a temporary and moving
+// it, where the move and the moved-from temporary's destructor are real work rather than a memcpy
+struct HeavyPayload
+{
+	static constexpr int size = 64;
+
+	HeavyPayload(int seed) : values(new int[size])
+	{
+		for (int i = 0; i < size; i++)
+			values[i] = seed + i;
+	}
+
+	HeavyPayload(const HeavyPayload& other) : values(new int[size])
+	{
+		std::copy(other.values, other.values + size, values);
+	}
+
+	HeavyPayload(HeavyPayload&& other) noexcept : values(other.values)
+	{
+		other.values = nullptr;
+	}
+
+	HeavyPayload& operator=(const HeavyPayload& other)
+	{
+		if (values == nullptr)
+			values = new int[size];
+		std::copy(other.values, other.values + size, values);
+		return *this;
+	}
+
+	HeavyPayload& operator=(HeavyPayload&& other) noexcept
+	{
+		std::swap(values, other.values);
+		return *this;
+	}
+
+	~HeavyPayload()
+	{
+		delete[] values;
+	}
+
+	int* values;
+};
+
+// Number of elements swept by the algorithm benchmarks
+constexpr int algorithm_count = 1 << 18;
+
+// Candidate iterators running slower than this multiple of raw pointers get flagged
+constexpr double iterator_slowdown_threshold = 1.5;
+
+// Number of elements swept by the vectorization kernels, small enough to stay in cache
+constexpr size_t simd_count = 4096;
+
+// Number of sweeps timed together, so the cycle counter overhead is negligible
+constexpr int simd_sweeps = 64;
+
+// Kernels reaching less than this fraction of the hand-written AVX2 throughput get flagged as not vectorized
+constexpr double vectorization_threshold = 0.5;
+
+// Number of ints pushed by the push_back latency benchmark, 16 MB, so the last reallocation of a doubling vector copies 8 MB
+constexpr size_t latency_count = size_t(1) << 22;
 
 template <template <typename> class Vec>
 TestResult test_push_back()
@@ -47,7 +137,7 @@ TestResult test_push_back()
 		Vec<MemoryCorrectnessItem> v;
 		v.push_back(MemoryCorrectnessItem{});
 
-		auto allocs_before = counted_malloc_allocations;
+		size_t allocs_before = counted_malloc_allocations;
 		int count_made = 1;
 
 		while (counted_malloc_allocations == allocs_before)
@@ -168,6 +258,51 @@ TestResult test_clear()
 	return TestResult::Pass;
 }
 
+template <template <typename> class Vec>
+TestResult test_shrink_to_fit()
+{
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Vec<MemoryCorrectnessItem> v;
+		v.reserve(1000);
+
+		for (int i = 0; i < 10; i++)
+			v.push_back(MemoryCorrectnessItem{ i });
+
+		auto bytes_before = counted_malloc_bytes_live();
+		uint64_t copies_before = MemoryCorrectnessItem::count_constructed_copy;
+
+		v.shrink_to_fit();
+
+		if (v.size() != 10) return TestResult::IncorrectResults;
+		if (v.capacity() < 10 || v.capacity() >= 1000) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 10; i++)
+			if (v[i].id != i) return TestResult::IncorrectResults;
+
+		// The capacity has to be given back to the allocator, not just forgotten about
+		if (counted_malloc_bytes_live() >= bytes_before) return TestResult::IncorrectResults;
+		if (counted_malloc_bytes_live() > v.capacity() * sizeof(MemoryCorrectnessItem)) return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 10) return TestResult::IncorrectObjectHandling;
+		if (MemoryCorrectnessItem::count_constructed_copy != copies_before) return TestResult::SuboptimalObjectHandling;
+
+		v.clear();
+		v.shrink_to_fit();
+
+		if (v.capacity() != 0) return TestResult::IncorrectResults;
+		if (counted_malloc_bytes_live() != 0) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	return TestResult::Pass;
+}
+
 template <typename Vec>
 TestResult test_empty()
 {
@@ -497,24 +632,880 @@ TestResult test_move_assignment()
 	return TestResult::Pass;
 }
 
+template <template <typename> class Vec>
+TestResult test_emplace_back()
+{
+	{
+		Vec<int> v;
+		v.emplace_back(42);
+		v.emplace_back(23);
+
+		if (v.size() != 2) return TestResult::IncorrectResults;
+		if (v[0] != 42) return TestResult::IncorrectResults;
+		if (v[1] != 23) return TestResult::IncorrectResults;
+	}
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	bool reserved_copies_or_moves;
+
+	{
+		Vec<MemoryCorrectnessItem> v;
+		v.reserve(8);
+
+		v.emplace_back(7);
+
+		if (v.size() != 1) return TestResult::IncorrectResults;
+		if (v[0].id != 7) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 1) return TestResult::IncorrectObjectHandling;
+		if (MemoryCorrectnessItem::count_constructed != 1) return TestResult::IncorrectObjectHandling;
+
+		reserved_copies_or_moves = MemoryCorrectnessItem::count_constructed_copy != 0 || MemoryCorrectnessItem::count_constructed_move != 0;
+	}
+
+	MemoryCorrectnessItem::reset();
+
+	{
+		Vec<MemoryCorrectnessItem> v;
+
+		for (int i = 0; i < 100; i++)
+			v.emplace_back(i);
+
+		for (int i = 0; i < 100; i++)
+			if (v[i].id != i) return TestResult::IncorrectResults;
+
+		if (MemoryCorrectnessItem::count_alive() != 100) return TestResult::IncorrectObjectHandling;
+
+		// Reallocation may move existing elements, but each new element must be built in place
+		if (MemoryCorrectnessItem::count_constructed != 100) return TestResult::SuboptimalObjectHandling;
+		if (MemoryCorrectnessItem::count_constructed_copy != 0) return TestResult::SuboptimalObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	if (reserved_copies_or_moves) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+TestResult test_iterators()
+{
+	Vec<int> v;
+
+	for (int i = 0; i < 100; i++)
+		v.push_back(i);
+
+	if (std::distance(v.begin(), v.end()) != 100) return TestResult::IncorrectResults;
+
+	int i = 0;
+	for (auto it = v.begin(); it != v.end(); ++it, ++i)
+		if (*it != v[i]) return TestResult::IncorrectResults;
+
+	int sum = 0;
+	for (auto&& x : v)
+		sum += x;
+
+	if (sum != 4950) return TestResult::IncorrectResults;
+
+	// Make sure the iterator gives out references to the elements
+	*(v.begin() + 10) = 69;
+	if (v[10] != 69) return TestResult::IncorrectResults;
+
+	if (v.end() - v.begin() != 100) return TestResult::IncorrectResults;
+	if (v.begin()[20] != 20) return TestResult::IncorrectResults;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+TestResult test_contiguous_iterator()
+{
+	Vec<int> v;
+
+	for (int i = 0; i < 100; i++)
+		v.push_back(i);
+
+	int* first = std::to_address(v.begin());
+
+	for (int i = 0; i < 100; i++)
+		if (first + i != &v[i]) return TestResult::IncorrectResults;
+
+	if (std::to_address(v.end()) != first + 100) return TestResult::IncorrectResults;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+TestResult test_insert_range()
+{
+	{
+		int src[] = { 2, 3, 4 };
+
+		Vec<int> v;
+		v.push_back(1);
+		v.push_back(5);
+
+		v.insert(v.begin() + 1, src, src + 3);
+
+		if (v.size() != 5) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 5; i++)
+			if (v[i] != i + 1) return TestResult::IncorrectResults;
+	}
+
+	MemoryCorrectnessItem src[bulk_count];
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	size_t bulk_allocs;
+
+	{
+		Vec<MemoryCorrectnessItem> v;
+
+		size_t allocs_before = counted_malloc_allocations;
+		v.insert(v.end(), src, src + bulk_count);
+		bulk_allocs = counted_malloc_allocations - allocs_before;
+
+		if (v.size() != bulk_count) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != bulk_count) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	// A range of known length should be copied straight into a single allocation
+	if (bulk_allocs > 1) return TestResult::SuboptimalObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != bulk_count) return TestResult::SuboptimalObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed != 0) return TestResult::SuboptimalObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_move != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+TestResult test_assign_range()
+{
+	{
+		int src[] = { 7, 8, 9, 10 };
+
+		Vec<int> v;
+		v.push_back(1);
+		v.push_back(2);
+
+		v.assign(src, src + 4);
+
+		if (v.size() != 4) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 4; i++)
+			if (v[i] != i + 7) return TestResult::IncorrectResults;
+	}
+
+	MemoryCorrectnessItem src[bulk_count];
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	size_t bulk_allocs;
+
+	{
+		Vec<MemoryCorrectnessItem> v;
+
+		for (int i = 0; i < 3; i++)
+			v.push_back(MemoryCorrectnessItem{});
+
+		size_t allocs_before = counted_malloc_allocations;
+		v.assign(src, src + bulk_count);
+		bulk_allocs = counted_malloc_allocations - allocs_before;
+
+		if (v.size() != bulk_count) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != bulk_count) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	if (bulk_allocs > 1) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+TestResult test_constructor_range()
+{
+	{
+		int src[] = { 1, 2, 3 };
+
+		Vec<int> v(src, src + 3);
+
+		if (v.size() != 3) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 3; i++)
+			if (v[i] != i + 1) return TestResult::IncorrectResults;
+	}
+
+	MemoryCorrectnessItem src[bulk_count];
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	size_t bulk_allocs;
+
+	{
+		Vec<MemoryCorrectnessItem> v(src, src + bulk_count);
+		bulk_allocs = counted_malloc_allocations;
+
+		if (v.size() != bulk_count) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != bulk_count) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	if (bulk_allocs > 1) return TestResult::SuboptimalObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != bulk_count) return TestResult::SuboptimalObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_move != 0) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+TestResult test_constructor_init_list()
+{
+	{
+		Vec<int> v{ 1, 2, 3 };
+
+		if (v.size() != 3) return TestResult::IncorrectResults;
+
+		for (int i = 0; i < 3; i++)
+			if (v[i] != i + 1) return TestResult::IncorrectResults;
+	}
+
+	MemoryCorrectnessItem::reset();
+	counted_malloc_reset();
+
+	{
+		Vec<MemoryCorrectnessItem> v{ MemoryCorrectnessItem{ 1 }, MemoryCorrectnessItem{ 2 }, MemoryCorrectnessItem{ 3 } };
+
+		if (v.size() != 3) return TestResult::IncorrectResults;
+		if (v[0].id != 1 || v[2].id != 3) return TestResult::IncorrectResults;
+		if (MemoryCorrectnessItem::count_alive() != 3) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (MemoryCorrectnessItem::count_alive() != 0) return TestResult::IncorrectObjectHandling;
+	if (counted_malloc_allocations != counted_malloc_deallocations) return TestResult::LeaksMemory;
+
+	// initializer_list elements are const, so one copy each is unavoidable, but nothing more
+	if (counted_malloc_allocations > 1) return TestResult::SuboptimalObjectHandling;
+	if (MemoryCorrectnessItem::count_constructed_copy != 3) return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+void benchmark_bulk_insert()
+{
+	constexpr int count = 10000;
+	static int src[count];
+
+	for (int i = 0; i < count; i++)
+		src[i] = i;
+
+	double push_back_ns = benchmark_ns([&] {
+		Vec<int> v;
+		for (int i = 0; i < count; i++)
+			v.push_back(src[i]);
+		do_not_optimize(v);
+	});
+
+	output_benchmark("push_back loop (10000 ints)", push_back_ns, "ns");
+
+	if constexpr (has_insert_range<Vec<int>, int> && has_begin_end<Vec<int>>)
+	{
+		double ns = benchmark_ns([&] {
+			Vec<int> v;
+			v.insert(v.end(), src, src + count);
+			do_not_optimize(v);
+		});
+		output_benchmark_comparison("insert (range, 10000 ints)", ns, "push_back loop", push_back_ns);
+	}
+	else
+		output_warning("insert (range, 10000 ints)", "not implemented");
+
+	if constexpr (has_assign_range<Vec<int>, int>)
+	{
+		double ns = benchmark_ns([&] {
+			Vec<int> v;
+			v.assign(src, src + count);
+			do_not_optimize(v);
+		});
+		output_benchmark_comparison("assign (range, 10000 ints)", ns, "push_back loop", push_back_ns);
+	}
+	else
+		output_warning("assign (range, 10000 ints)", "not implemented");
+
+	if constexpr (has_constructor_range<Vec<int>, int>)
+	{
+		double ns = benchmark_ns([&] {
+			Vec<int> v(src, src + count);
+			do_not_optimize(v);
+		});
+		output_benchmark_comparison("(constructor) (range, 10000 ints)", ns, "push_back loop", push_back_ns);
+	}
+	else
+		output_warning("(constructor) (range, 10000 ints)", "not implemented");
+}
+
+template <template <typename> class Vec>
+void benchmark_emplace_back()
+{
+	constexpr int count = 10000;
+
+	double push_back_ns = benchmark_ns([&] {
+		Vec<HeavyPayload> v;
+		v.reserve(count);
+		for (int i = 0; i < count; i++)
+			v.push_back(HeavyPayload{ i });
+		do_not_optimize(v);
+	});
+
+	double emplace_back_ns = benchmark_ns([&] {
+		Vec<HeavyPayload> v;
+		v.reserve(count);
+		for (int i = 0; i < count; i++)
+			v.emplace_back(i);
+		do_not_optimize(v);
+	});
+
+	output_benchmark_comparison("emplace_back (10000 x 256 byte buffers)", emplace_back_ns, "push_back", push_back_ns);
+}
+
+void output_iterator_comparison(const char* name, double candidate_ns, double raw_ns)
+{
+	output_benchmark_comparison(name, candidate_ns, "raw pointers", raw_ns);
+
+	if (candidate_ns > raw_ns * iterator_slowdown_threshold)
+		output_warning(name, "iterators are much slower than raw pointers, check they don't block vectorization");
+}
+
+template <template <typename> class Vec, typename... Policy>
+void benchmark_algorithms(const char* policy_name, Policy&&... policy)
+{
+	static int src[algorithm_count];
+
+	uint32_t seed = 12345;
+	for (int i = 0; i < algorithm_count; i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		src[i] = seed >> 2;
+	}
+
+	Vec<int> v;
+	for (int i = 0; i < algorithm_count; i++)
+		v.push_back(src[i]);
+
+	// The raw pointer loops run on a buffer of their own, as the candidate's storage needn't be contiguous. They're
+	// bounded at run time as well, otherwise they get an unfair advantage from a constant trip count.
+	std::vector<int> baseline(src, src + algorithm_count);
+	int* raw = baseline.data();
+	int* raw_end = raw + algorithm_count;
+	make_opaque(raw_end);
+
+	char name[128];
+
+	double candidate_ns = benchmark_ns([&] {
+		std::copy(src, src + algorithm_count, v.begin());
+		std::sort(policy..., v.begin(), v.end());
+	});
+	double raw_ns = benchmark_ns([&] {
+		std::copy(src, src + algorithm_count, raw);
+		std::sort(policy..., raw, raw_end);
+	});
+	snprintf(name, sizeof(name), "std::sort (%s)", policy_name);
+	output_iterator_comparison(name, candidate_ns, raw_ns);
+
+	candidate_ns = benchmark_ns([&] {
+		do_not_optimize(std::reduce(policy..., v.begin(), v.end(), 0u));
+	});
+	raw_ns = benchmark_ns([&] {
+		do_not_optimize(std::reduce(policy..., raw, raw_end, 0u));
+	});
+	snprintf(name, sizeof(name), "std::reduce (%s)", policy_name);
+	output_iterator_comparison(name, candidate_ns, raw_ns);
+
+	candidate_ns = benchmark_ns([&] {
+		do_not_optimize(std::find(policy..., v.begin(), v.end(), -1));
+	});
+	raw_ns = benchmark_ns([&] {
+		do_not_optimize(std::find(policy..., raw, raw_end, -1));
+	});
+	snprintf(name, sizeof(name), "std::find (%s)", policy_name);
+	output_iterator_comparison(name, candidate_ns, raw_ns);
+
+	candidate_ns = benchmark_ns([&] {
+		std::transform(policy..., v.begin(), v.end(), v.begin(), [](int x) { return x ^ 0x55555555; });
+	});
+	raw_ns = benchmark_ns([&] {
+		std::transform(policy..., raw, raw_end, raw, [](int x) { return x ^ 0x55555555; });
+	});
+	snprintf(name, sizeof(name), "std::transform (%s)", policy_name);
+	output_iterator_comparison(name, candidate_ns, raw_ns);
+}
+
+template <template <typename> class Vec>
+void benchmark_accumulate()
+{
+	Vec<int> v;
+	std::vector<int> baseline;
+	for (int i = 0; i < algorithm_count; i++)
+	{
+		v.push_back(i);
+		baseline.push_back(i);
+	}
+
+	int* raw = baseline.data();
+	int* raw_end = raw + algorithm_count;
+	make_opaque(raw_end);
+
+	double candidate_ns = benchmark_ns([&] {
+		do_not_optimize(std::accumulate(v.begin(), v.end(), 0u));
+	});
+	double raw_ns = benchmark_ns([&] {
+		do_not_optimize(std::accumulate(raw, raw_end, 0u));
+	});
+	output_iterator_comparison("std::accumulate", candidate_ns, raw_ns);
+}
+
+template <typename Vec>
+auto kernel_sum(Vec& v, size_t count)
+{
+	int sum = 0;
+	for (size_t i = 0; i < count; i++)
+		sum += v[i];
+	return sum;
+}
+
+template <typename Vec, typename T>
+void kernel_scale(Vec& v, size_t count, T factor)
+{
+	for (size_t i = 0; i < count; i++)
+		v[i] = v[i] * factor;
+}
+
+template <typename Vec, typename T>
+int kernel_compare(Vec& v, size_t count, T limit)
+{
+	int matches = 0;
+	for (size_t i = 0; i < count; i++)
+		matches += v[i] > limit;
+	return matches;
+}
+
+#ifdef TEST_HARNESS_AVX2_BASELINE
+__attribute__((target("avx2"))) int avx2_sum(const int* data, size_t count)
+{
+	__m256i acc0 = _mm256_setzero_si256();
+	__m256i acc1 = _mm256_setzero_si256();
+
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		acc0 = _mm256_add_epi32(acc0, _mm256_loadu_si256((const __m256i*)(data + i)));
+		acc1 = _mm256_add_epi32(acc1, _mm256_loadu_si256((const __m256i*)(data + i + 8)));
+	}
+
+	alignas(32) int lanes[8];
+	_mm256_store_si256((__m256i*)lanes, _mm256_add_epi32(acc0, acc1));
+
+	int sum = 0;
+	for (int lane = 0; lane < 8; lane++)
+		sum += lanes[lane];
+	for (; i < count; i++)
+		sum += data[i];
+	return sum;
+}
+
+__attribute__((target("avx2"))) void avx2_scale(int* data, size_t count, int factor)
+{
+	__m256i f = _mm256_set1_epi32(factor);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_si256((__m256i*)(data + i), _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(data + i)), f));
+	for (; i < count; i++)
+		data[i] *= factor;
+}
+
+__attribute__((target("avx2"))) void avx2_scale(float* data, size_t count, float factor)
+{
+	__m256 f = _mm256_set1_ps(factor);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), f));
+	for (; i < count; i++)
+		data[i] *= factor;
+}
+
+__attribute__((target("avx2"))) int avx2_compare(const int* data, size_t count, int limit)
+{
+	__m256i l = _mm256_set1_epi32(limit);
+
+	int matches = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i gt = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(data + i)), l);
+		matches += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(gt)));
+	}
+	for (; i < count; i++)
+		matches += data[i] > limit;
+	return matches;
+}
+
+__attribute__((target("avx2"))) int avx2_compare(const float* data, size_t count, float limit)
+{
+	__m256 l = _mm256_set1_ps(limit);
+
+	int matches = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		matches += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(data + i), l, _CMP_GT_OQ)));
+	for (; i < count; i++)
+		matches += data[i] > limit;
+	return matches;
+}
+#endif
+
+void output_vectorization(const char* name, double elements_per_cycle, double baseline_elements_per_cycle)
+{
+	if (baseline_elements_per_cycle <= 0)
+	{
+		output_benchmark(name, elements_per_cycle, "elements/cycle");
+		return;
+	}
+
+	double fraction = elements_per_cycle / baseline_elements_per_cycle;
+	printf("  %s: %.2f elements/cycle (AVX2: %.2f, %.2fx)\n", name, elements_per_cycle, baseline_elements_per_cycle, fraction);
+	record_benchmark(name, elements_per_cycle, "elements/cycle");
+
+	if (fraction < vectorization_threshold)
+		output_warning(name, "well below hand-written AVX2, likely not vectorized");
+}
+
+// Measures elements/cycle of a kernel over simd_sweeps sweeps of simd_count elements
+template <typename F>
+double elements_per_cycle(F&& kernel)
+{
+	double cycles = benchmark_cycles([&] {
+		for (int sweep = 0; sweep < simd_sweeps; sweep++)
+			kernel();
+	});
+
+	return double(simd_count) * simd_sweeps / cycles;
+}
+
+template <template <typename> class Vec, typename T>
+void benchmark_vectorization(const char* type_name)
+{
+	Vec<T> v;
+	for (size_t i = 0; i < simd_count; i++)
+		v.push_back(T(i % 100));
+
+	// Opaque count and constants, so the kernels are compiled as they would be for arbitrary input
+	size_t count = simd_count;
+	T factor = T(1);
+	T limit = T(50);
+	make_opaque(count);
+	make_opaque(factor);
+	make_opaque(limit);
+
+	static T raw[simd_count];
+	for (size_t i = 0; i < simd_count; i++)
+		raw[i] = T(i % 100);
+
+	double baseline_sum = 0;
+	double baseline_scale = 0;
+	double baseline_compare = 0;
+
+#ifdef TEST_HARNESS_AVX2_BASELINE
+	if (__builtin_cpu_supports("avx2"))
+	{
+		if constexpr (std::is_same_v<T, int>)
+			baseline_sum = elements_per_cycle([&] { do_not_optimize(avx2_sum(raw, count)); });
+		baseline_scale = elements_per_cycle([&] { avx2_scale(raw, count, factor); do_not_optimize(raw); });
+		baseline_compare = elements_per_cycle([&] { do_not_optimize(avx2_compare(raw, count, limit)); });
+	}
+#endif
+
+	char name[128];
+
+	// Float sums can't be reordered into vector lanes without -ffast-math, so only integers are summed
+	if constexpr (std::is_same_v<T, int>)
+	{
+		snprintf(name, sizeof(name), "operator[] sum (%s)", type_name);
+		output_vectorization(name, elements_per_cycle([&] { do_not_optimize(kernel_sum(v, count)); }), baseline_sum);
+	}
+
+	snprintf(name, sizeof(name), "operator[] scale (%s)", type_name);
+	output_vectorization(name, elements_per_cycle([&] { kernel_scale(v, count, factor); do_not_optimize(v); }), baseline_scale);
+
+	snprintf(name, sizeof(name), "operator[] compare (%s)", type_name);
+	output_vectorization(name, elements_per_cycle([&] { do_not_optimize(kernel_compare(v, count, limit)); }), baseline_compare);
+
+	if constexpr (has_data<Vec<T>, T>)
+	{
+		T* data = v.data();
+
+		if constexpr (std::is_same_v<T, int>)
+		{
+			snprintf(name, sizeof(name), "data() sum (%s)", type_name);
+			output_vectorization(name, elements_per_cycle([&] { do_not_optimize(kernel_sum(data, count)); }), baseline_sum);
+		}
+
+		snprintf(name, sizeof(name), "data() scale (%s)", type_name);
+		output_vectorization(name, elements_per_cycle([&] { kernel_scale(data, count, factor); do_not_optimize(data); }), baseline_scale);
+
+		snprintf(name, sizeof(name), "data() compare (%s)", type_name);
+		output_vectorization(name, elements_per_cycle([&] { do_not_optimize(kernel_compare(data, count, limit)); }), baseline_compare);
+	}
+	else
+		output_warning("data()", "not implemented");
+}
+
+template <template <typename> class Vec>
+void benchmark_shrink_to_fit()
+{
+	constexpr int count = 1 << 23;
+
+	size_t rss_start = read_rss_bytes();
+	size_t rss_peak = rss_start;
+	size_t rss_after_clear;
+	size_t rss_after_shrink;
+
+	double ns = benchmark_ns([&] {
+		Vec<int> v;
+		size_t capacity = v.capacity();
+
+		for (int i = 0; i < count; i++)
+		{
+			v.push_back(i);
+
+			if (v.capacity() != capacity)
+			{
+				capacity = v.capacity();
+				rss_peak = std::max(rss_peak, read_rss_bytes());
+			}
+		}
+
+		rss_peak = std::max(rss_peak, read_rss_bytes());
+
+		v.clear();
+		rss_after_clear = read_rss_bytes();
+
+		v.shrink_to_fit();
+		rss_after_shrink = read_rss_bytes();
+	});
+
+	if (rss_start == 0)
+	{
+		output_warning("shrink_to_fit (RSS)", "can't read /proc/self/statm on this platform");
+		return;
+	}
+
+	output_benchmark("grow to 32 MB then shrink_to_fit", ns / 1e6, "ms");
+	printf("  shrink_to_fit (RSS): peak %.1f MB, after clear %.1f MB, after shrink_to_fit %.1f MB (start %.1f MB)\n",
+		rss_peak / 1e6, rss_after_clear / 1e6, rss_after_shrink / 1e6, rss_start / 1e6);
+	record_benchmark("shrink_to_fit (RSS peak)", rss_peak / 1e6, "MB");
+	record_benchmark("shrink_to_fit (RSS after clear)", rss_after_clear / 1e6, "MB");
+	record_benchmark("shrink_to_fit (RSS after shrink_to_fit)", rss_after_shrink / 1e6, "MB");
+
+	if (rss_after_shrink >= rss_after_clear)
+		output_warning("shrink_to_fit (RSS)", "no memory returned to the OS");
+}
+
+// Throughput averages away the reallocations, so every push_back is timed on its own to show the tail they make
+template <template <typename> class Vec>
+void benchmark_push_back_latency()
+{
+	static LatencyHistogram histogram;
+	static LatencyHistogram std_histogram;
+	histogram = {};
+	std_histogram = {};
+
+	std::vector<uint64_t> samples;
+	std::vector<uint64_t> std_samples;
+
+	{
+		Vec<int> v;
+		record_latencies(histogram, samples, latency_count, [&](size_t i) { v.push_back(int(i)); });
+		do_not_optimize(v);
+	}
+
+	{
+		std::vector<int> v;
+		record_latencies(std_histogram, std_samples, latency_count, [&](size_t i) { v.push_back(int(i)); });
+		do_not_optimize(v);
+	}
+
+	printf("  push_back latency (%zu ints):\n", latency_count);
+	output_latency("  candidate", histogram);
+	output_latency("  std::vector", std_histogram);
+	output_latency_spikes("  candidate spikes at element", histogram, samples);
+	output_latency_spikes("  std::vector spikes at element", std_histogram, std_samples);
+
+	record_benchmark("push_back latency (p99.9)", double(histogram.percentile(0.999)), "cycles");
+	record_benchmark("push_back latency (max)", double(histogram.max), "cycles");
+}
+
+// Tests evaluated by the compiler, for candidates that can be used in constant expressions. Each returns a
+// TestResult, so run() prints what the compiler worked out and constexpr_gate() can assert on it.
+template <template <typename> class Vec>
+constexpr TestResult constexpr_usable()
+{
+	Vec<int> v;
+	v.push_back(1);
+	return v.size() == 1 ? TestResult::Pass : TestResult::IncorrectResults;
+}
+
+template <template <typename> class Vec>
+constexpr TestResult constexpr_push_back()
+{
+	LifecycleCounts counts;
+
+	{
+		Vec<ConstexprItem> v;
+		for (int i = 0; i < 100; i++)
+			v.push_back(ConstexprItem(counts, i));
+
+		if (v.size() != 100) return TestResult::IncorrectResults;
+		for (int i = 0; i < 100; i++)
+			if (v[i].id != i) return TestResult::IncorrectResults;
+
+		if (counts.count_alive() != 100) return TestResult::IncorrectObjectHandling;
+	}
+
+	if (counts.count_alive() != 0 || counts.errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	// Elements pushed as temporaries and moved on each reallocation never need copying
+	if (counts.constructed_copy != 0)
+		return TestResult::SuboptimalObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+constexpr TestResult constexpr_copy_move()
+{
+	LifecycleCounts counts;
+
+	{
+		Vec<ConstexprItem> v;
+		for (int i = 0; i < 10; i++)
+			v.push_back(ConstexprItem(counts, i));
+
+		Vec<ConstexprItem> copy(v);
+		if (copy.size() != 10 || v.size() != 10) return TestResult::IncorrectResults;
+		for (int i = 0; i < 10; i++)
+			if (copy[i].id != i || v[i].id != i) return TestResult::IncorrectResults;
+
+		if (counts.count_alive() != 20) return TestResult::IncorrectObjectHandling;
+
+		// Moving the vector hands over its buffer, leaving the elements where they are
+		int constructed_before = counts.constructed_copy + counts.constructed_move;
+		Vec<ConstexprItem> moved(std::move(copy));
+		if (moved.size() != 10) return TestResult::IncorrectResults;
+		for (int i = 0; i < 10; i++)
+			if (moved[i].id != i) return TestResult::IncorrectResults;
+
+		if (counts.count_alive() != 20) return TestResult::IncorrectObjectHandling;
+		if (counts.constructed_copy + counts.constructed_move != constructed_before)
+			return TestResult::SuboptimalObjectHandling;
+	}
+
+	if (counts.count_alive() != 0 || counts.errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+constexpr TestResult constexpr_resize_clear()
+{
+	LifecycleCounts counts;
+
+	{
+		Vec<ConstexprItem> v;
+		for (int i = 0; i < 20; i++)
+			v.push_back(ConstexprItem(counts, i));
+
+		v.resize(5);
+		if (v.size() != 5) return TestResult::IncorrectResults;
+		if (counts.count_alive() != 5) return TestResult::IncorrectObjectHandling;
+
+		v.clear();
+		if (v.size() != 0) return TestResult::IncorrectResults;
+		if (counts.count_alive() != 0) return TestResult::IncorrectObjectHandling;
+
+		// Reuses the buffer clear left behind
+		v.push_back(ConstexprItem(counts, 42));
+		if (v.size() != 1 || v[0].id != 42) return TestResult::IncorrectResults;
+	}
+
+	if (counts.count_alive() != 0 || counts.errors_occurred != 0)
+		return TestResult::IncorrectObjectHandling;
+
+	return TestResult::Pass;
+}
+
+template <template <typename> class Vec>
+concept constexpr_testable = has_push_back<Vec<ConstexprItem>, ConstexprItem> && has_size<Vec<ConstexprItem>> &&
+	has_operator_sq_bk<Vec<ConstexprItem>, ConstexprItem>;
+
+// Fails the build when a candidate that can be used in constant expressions fails a test there, with the compiler
+// explaining the undefined behaviour or leak that stopped evaluation. Candidates that can't be are let through.
+template <template <typename> class Vec>
+constexpr bool constexpr_gate()
+{
+	if constexpr (constexpr_testable<Vec>)
+	{
+		if constexpr (constant_evaluable<constexpr_usable<Vec>>)
+		{
+			static_assert(constexpr_passes<constexpr_push_back<Vec>>(), "constexpr push_back failed");
+
+			if constexpr (std::is_copy_constructible_v<Vec<ConstexprItem>>)
+				static_assert(constexpr_passes<constexpr_copy_move<Vec>>(), "constexpr copy and move failed");
+
+			if constexpr (has_resize<Vec<ConstexprItem>> && has_clear<Vec<ConstexprItem>>)
+				static_assert(constexpr_passes<constexpr_resize_clear<Vec>>(), "constexpr resize and clear failed");
+		}
+	}
+
+	return true;
+}
+
 template <template <typename> class Vec>
 void run()
 {
 	using VecInt = Vec<int>;
 
-	printf("\n%s\n-------------------------------\n", typeid(Vec).name());
+	printf("\n%s\n-------------------------------\n", typeid(Vec<int>).name());
 
 	printf("Class methods:\n");
 
 	if constexpr (has_size<VecInt>)
-		output_result("size", test_size<VecInt>());
+		output_result("size", test_size<VecInt>);
 	else
 		output_warning("size", "not implemented");
 
 	if constexpr (has_capacity<VecInt>)
 	{
 		if constexpr (has_push_back<VecInt, int>)
-			output_result("capacity", test_capacity<VecInt>());
+			output_result("capacity", test_capacity<VecInt>);
 		else
 			output_warning("capacity", "can't test, missing requirements: push_back");
 	}
@@ -524,7 +1515,7 @@ void run()
 	if constexpr (has_reserve<VecInt>)
 	{
 		if constexpr (has_capacity<VecInt> && has_push_back<VecInt, int>)
-			output_result("reserve", test_reserve<Vec>());
+			output_result("reserve", test_reserve<Vec>);
 		else
 			output_warning("reserve", "can't test, missing requirements: push_back, capacity");
 	}
@@ -534,7 +1525,7 @@ void run()
 	if constexpr (has_resize<VecInt>)
 	{
 		if constexpr (has_push_back<VecInt, int> && has_size<VecInt>)
-			output_result("resize", test_resize<Vec>());
+			output_result("resize", test_resize<Vec>);
 		else
 			output_warning("resize", "can't test, missing requirements: push_back, size");
 	}
@@ -544,7 +1535,7 @@ void run()
 	if constexpr (has_push_back<VecInt, int>)
 	{
 		if constexpr (has_size<VecInt>)
-			output_result("push_back", test_push_back<Vec>());
+			output_result("push_back", test_push_back<Vec>);
 		else
 			output_warning("push_back", "can't test, missing requirements: size");
 	}
@@ -554,7 +1545,7 @@ void run()
 	if constexpr (has_empty<VecInt>)
 	{
 		if constexpr (has_push_back<VecInt, int>)
-			output_result("empty", test_empty<VecInt>());
+			output_result("empty", test_empty<VecInt>);
 		else
 			output_warning("empty", "can't test, missing requirements: push_back");
 	}
@@ -564,17 +1555,27 @@ void run()
 	if constexpr (has_clear<VecInt>)
 	{
 		if constexpr (has_push_back<VecInt, int> && has_size<VecInt> && has_capacity<VecInt>)
-			output_result("clear", test_clear<Vec>());
+			output_result("clear", test_clear<Vec>);
 		else
 			output_warning("clear", "can't test, missing requirements: push_back, size, capacity");
 	}
 	else
 		output_warning("clear", "not implemented");
 
+	if constexpr (has_shrink_to_fit<VecInt>)
+	{
+		if constexpr (has_push_back<VecInt, int> && has_size<VecInt> && has_capacity<VecInt> && has_reserve<VecInt> && has_clear<VecInt> && has_operator_sq_bk<VecInt, int>)
+			output_result("shrink_to_fit", test_shrink_to_fit<Vec>);
+		else
+			output_warning("shrink_to_fit", "can't test, missing requirements: push_back, size, capacity, reserve, clear, operator[]");
+	}
+	else
+		output_warning("shrink_to_fit", "not implemented");
+
 	if constexpr (has_operator_sq_bk<VecInt, int>)
 	{
 		if constexpr (has_push_back<VecInt, int>)
-			output_result("operator[]", test_operator_sq_bk<Vec>());
+			output_result("operator[]", test_operator_sq_bk<Vec>);
 		else
 			output_warning("operator[]", "can't test, missing requirements: push_back");
 	}
@@ -584,7 +1585,7 @@ void run()
 	if constexpr (has_at<VecInt, int>)
 	{
 		if constexpr (has_push_back<VecInt, int>)
-			output_result("at", test_at<Vec>());
+			output_result("at", test_at<Vec>);
 		else
 			output_warning("at", "can't test, missing requirements: push_back");
 	}
@@ -594,7 +1595,7 @@ void run()
 	if constexpr (has_front<VecInt, int>)
 	{
 		if constexpr (has_push_back<VecInt, int>)
-			output_result("front", test_front<Vec>());
+			output_result("front", test_front<Vec>);
 		else
 			output_warning("front", "can't test, missing requirements: push_back");
 	}
@@ -604,7 +1605,7 @@ void run()
 	if constexpr (has_back<VecInt, int>)
 	{
 		if constexpr (has_push_back<VecInt, int>)
-			output_result("back", test_back<Vec>());
+			output_result("back", test_back<Vec>);
 		else
 			output_warning("back", "can't test, missing requirements: push_back");
 	}
@@ -614,7 +1615,7 @@ void run()
 	if constexpr (std::constructible_from<VecInt, const VecInt&>)
 	{
 		if constexpr (has_push_back<VecInt, int> && has_size<VecInt> && has_operator_sq_bk<VecInt, int>)
-			output_result("(constructor) (copy)", test_copy_construct<Vec>());
+			output_result("(constructor) (copy)", test_copy_construct<Vec>);
 		else
 			output_warning("(constructor) (copy)", "can't test, missing requirements: push_back, size, operator[]");
 	}
@@ -624,7 +1625,7 @@ void run()
 	if constexpr (std::constructible_from<VecInt, VecInt&&>)
 	{
 		if constexpr (has_push_back<VecInt, int> && has_size<VecInt> && has_operator_sq_bk<VecInt, int>)
-			output_result("(constructor) (move)", test_move_construct<Vec>());
+			output_result("(constructor) (move)", test_move_construct<Vec>);
 		else
 			output_warning("(constructor) (move)", "can't test, missing requirements: push_back, size, operator[]");
 	}
@@ -634,7 +1635,7 @@ void run()
 	if constexpr (std::is_assignable_v<VecInt, const VecInt&>)
 	{
 		if constexpr (has_push_back<VecInt, int> && has_size<VecInt> && has_operator_sq_bk<VecInt, int>)
-			output_result("operator=(T&) (copy assignment)", test_copy_assignment<Vec>());
+			output_result("operator=(T&) (copy assignment)", test_copy_assignment<Vec>);
 		else
 			output_warning("operator=(T&) (copy assignment)", "can't test, missing requirements: push_back, size, operator[]");
 	}
@@ -644,7 +1645,7 @@ void run()
 	if constexpr (std::is_assignable_v<VecInt, VecInt&&>)
 	{
 		if constexpr (has_push_back<VecInt, int> && has_size<VecInt> && has_operator_sq_bk<VecInt, int>)
-			output_result("operator=(T&&) (move assignment)", test_move_assignment<Vec>());
+			output_result("operator=(T&&) (move assignment)", test_move_assignment<Vec>);
 		else
 			output_warning("operator=(T&&) (move assignment)", "can't test, missing requirements: push_back, size, operator[]");
 	}
@@ -652,16 +1653,174 @@ void run()
 		output_warning("operator=(T&&) (move assignment)", "not implemented");
 
 
+	if constexpr (has_emplace_back<VecInt, int>)
+	{
+		if constexpr (has_size<VecInt> && has_operator_sq_bk<VecInt, int> && has_reserve<VecInt>)
+			output_result("emplace_back", test_emplace_back<Vec>);
+		else
+			output_warning("emplace_back", "can't test, missing requirements: size, operator[], reserve");
+	}
+	else
+		output_warning("emplace_back", "not implemented");
+
+	if constexpr (has_random_access_iterator<VecInt>)
+	{
+		if constexpr (has_push_back<VecInt, int> && has_operator_sq_bk<VecInt, int>)
+			output_result("begin/end (random access)", test_iterators<Vec>);
+		else
+			output_warning("begin/end (random access)", "can't test, missing requirements: push_back, operator[]");
+	}
+	else if constexpr (has_begin_end<VecInt>)
+		output_result("begin/end (random access)", TestResult::IncorrectResults);
+	else
+		output_warning("begin/end (random access)", "not implemented");
+
+	if constexpr (has_contiguous_iterator<VecInt>)
+	{
+		if constexpr (has_push_back<VecInt, int> && has_operator_sq_bk<VecInt, int> && has_random_access_iterator<VecInt>)
+			output_result("begin/end (contiguous)", test_contiguous_iterator<Vec>);
+		else
+			output_warning("begin/end (contiguous)", "can't test, missing requirements: push_back, operator[], random access iterator");
+	}
+	else if constexpr (has_begin_end<VecInt>)
+		output_result("begin/end (contiguous)", TestResult::IncorrectResults);
+	else
+		output_warning("begin/end (contiguous)", "not implemented");
+
+	if constexpr (has_insert_range<VecInt, int>)
+	{
+		if constexpr (has_push_back<VecInt, int> && has_size<VecInt> && has_operator_sq_bk<VecInt, int> && has_begin_end<VecInt>)
+			output_result("insert (range)", test_insert_range<Vec>);
+		else
+			output_warning("insert (range)", "can't test, missing requirements: push_back, size, operator[], begin, end");
+	}
+	else
+		output_warning("insert (range)", "not implemented");
+
+	if constexpr (has_assign_range<VecInt, int>)
+	{
+		if constexpr (has_push_back<VecInt, int> && has_size<VecInt> && has_operator_sq_bk<VecInt, int>)
+			output_result("assign (range)", test_assign_range<Vec>);
+		else
+			output_warning("assign (range)", "can't test, missing requirements: push_back, size, operator[]");
+	}
+	else
+		output_warning("assign (range)", "not implemented");
+
+	if constexpr (has_constructor_range<VecInt, int>)
+	{
+		if constexpr (has_size<VecInt> && has_operator_sq_bk<VecInt, int>)
+			output_result("(constructor) (range)", test_constructor_range<Vec>);
+		else
+			output_warning("(constructor) (range)", "can't test, missing requirements: size, operator[]");
+	}
+	else
+		output_warning("(constructor) (range)", "not implemented");
+
+	if constexpr (has_constructor_init_list<VecInt, int>)
+	{
+		if constexpr (has_size<VecInt> && has_operator_sq_bk<VecInt, int>)
+			output_result("(constructor) (initializer_list)", test_constructor_init_list<Vec>);
+		else
+			output_warning("(constructor) (initializer_list)", "can't test, missing requirements: size, operator[]");
+	}
+	else
+		output_warning("(constructor) (initializer_list)", "not implemented");
+
 	if constexpr (has_push_back<VecInt, int>)
-		output_result("(destructor)", test_destructor<Vec>());
+		output_result("(destructor)", test_destructor<Vec>);
 	else
 		output_warning("(destructor)", "can't test, missing requirements: push_back");
 
 	// if constexpr (has_push_back<VecInt, int>)
-	// 	output_result("clean up (growth)", test_cleanup_during_growth<Vec>());
+	// 	output_result("clean up (growth)", test_cleanup_during_growth<Vec>);
 	// else
 	// 	output_warning("clean up (growth)", "can't test, missing requirements: push_back");
 
+	printf("Constant evaluation:\n");
+
+	if constexpr (!constexpr_testable<Vec>)
+		output_warning("constexpr", "can't test, missing requirements: push_back, size, operator[]");
+	else if constexpr (!constant_evaluable<constexpr_usable<Vec>>)
+		output_warning("constexpr", "can't be used in constant expressions");
+	else
+	{
+		output_constexpr_result<constexpr_push_back<Vec>>("constexpr push_back");
+
+		if constexpr (std::is_copy_constructible_v<Vec<ConstexprItem>>)
+			output_constexpr_result<constexpr_copy_move<Vec>>("constexpr copy and move");
+		else
+			output_warning("constexpr copy and move", "can't test, missing requirements: copy constructor");
+
+		if constexpr (has_resize<Vec<ConstexprItem>> && has_clear<Vec<ConstexprItem>>)
+			output_constexpr_result<constexpr_resize_clear<Vec>>("constexpr resize and clear");
+		else
+			output_warning("constexpr resize and clear", "can't test, missing requirements: resize, clear");
+	}
+
+
+	printf("Benchmarks:\n");
+
+	if constexpr (has_push_back<VecInt, int>)
+		run_benchmark("bulk insert", benchmark_bulk_insert<Vec>);
+	else
+		output_warning("bulk insert", "can't test, missing requirements: push_back");
+
+	if constexpr (has_push_back<VecInt, int>)
+		run_benchmark("push_back latency", benchmark_push_back_latency<Vec>);
+	else
+		output_warning("push_back latency", "can't test, missing requirements: push_back");
+
+	if constexpr (has_shrink_to_fit<VecInt>)
+	{
+		if constexpr (has_push_back<VecInt, int> && has_capacity<VecInt> && has_clear<VecInt>)
+			run_benchmark("shrink_to_fit (benchmark)", benchmark_shrink_to_fit<Vec>);
+		else
+			output_warning("shrink_to_fit (benchmark)", "can't test, missing requirements: push_back, capacity, clear");
+	}
+	else
+		output_warning("shrink_to_fit (benchmark)", "not implemented");
+
+	if constexpr (has_emplace_back<VecInt, int>)
+	{
+		if constexpr (has_push_back<VecInt, int> && has_reserve<VecInt>)
+			run_benchmark("emplace_back (benchmark)", benchmark_emplace_back<Vec>);
+		else
+			output_warning("emplace_back (benchmark)", "can't test, missing requirements: push_back, reserve");
+	}
+	else
+		output_warning("emplace_back (benchmark)", "not implemented");
+
+	if constexpr (has_random_access_iterator<VecInt>)
+	{
+		if constexpr (has_push_back<VecInt, int>)
+		{
+			run_benchmark("algorithms", [] {
+				benchmark_accumulate<Vec>();
+				benchmark_algorithms<Vec>("sequential");
+#ifdef TEST_HARNESS_PARALLEL_STL
+				benchmark_algorithms<Vec>("par_unseq", std::execution::par_unseq);
+#else
+				output_warning("algorithms (par_unseq)", "can't test, built without TBB");
+#endif
+			});
+		}
+		else
+			output_warning("algorithms", "can't test, missing requirements: push_back");
+	}
+	else
+		output_warning("algorithms", "can't test, missing requirements: random access iterator");
+
+	if constexpr (has_push_back<VecInt, int> && has_operator_sq_bk<VecInt, int>)
+	{
+		run_benchmark("vectorization", [] {
+			benchmark_vectorization<Vec, int>("int");
+			benchmark_vectorization<Vec, float>("float");
+		});
+	}
+	else
+		output_warning("vectorization", "can't test, missing requirements: push_back, operator[]");
+
 	printf("\n");
 }
 